@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <zephyr/sys/util.h>
+
+#include "app_aggregate.h"
+
+void app_aggregate_reset(struct app_aggregate *agg)
+{
+	memset(agg, 0, sizeof(*agg));
+}
+
+void app_aggregate_add(struct app_aggregate *agg, int32_t value)
+{
+	int64_t value_q = (int64_t) value << APP_AGGREGATE_MEAN_FRAC_BITS;
+	int64_t before;
+	int64_t after;
+	int64_t product;
+
+	agg->n++;
+	agg->sum += value;
+
+	if (agg->n == 1) {
+		agg->min = value;
+		agg->max = value;
+		agg->mean_q = value_q;
+		agg->m2_q = 0;
+		return;
+	}
+
+	agg->min = MIN(agg->min, value);
+	agg->max = MAX(agg->max, value);
+
+	before = value_q - agg->mean_q;
+	agg->mean_q = DIV_ROUND_CLOSEST(agg->sum * (1 << APP_AGGREGATE_MEAN_FRAC_BITS),
+					(int64_t) agg->n);
+	after = value_q - agg->mean_q;
+
+	/* The mean moves towards the reading, so both deviations have the same sign. Rounding
+	 * can put them a fraction of a step either side of zero; such a reading adds nothing.
+	 */
+	if (__builtin_mul_overflow(before, after, &product) ||
+	    ((product > 0) && (agg->m2_q > (UINT64_MAX - (uint64_t) product)))) {
+		agg->m2_q = UINT64_MAX;
+	} else if (product > 0) {
+		agg->m2_q += (uint64_t) product;
+	}
+}
+
+uint64_t app_aggregate_variance_q(const struct app_aggregate *agg)
+{
+	if (agg->n < 2) {
+		return 0;
+	}
+
+	return agg->m2_q / (agg->n - 1);
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __APP_AGGREGATE_H__
+#define __APP_AGGREGATE_H__
+
+#include <stdint.h>
+
+/* Fraction bits kept in the running mean */
+#define APP_AGGREGATE_MEAN_FRAC_BITS 8
+
+/*
+ * Running min, max, mean and variance of one channel over a window, updated with Welford's
+ * method in fixed point so memory stays constant however many readings the window holds. The
+ * mean is taken from an exact sum, so rounding never accumulates in it. Readings are int32 in
+ * whatever unit the caller picks and should stay within +/-2^22; beyond that the sum of squared
+ * deviations saturates instead of wrapping.
+ */
+struct app_aggregate {
+	int64_t sum;    /* sum of the readings */
+	int64_t mean_q; /* sum / n rounded to nearest, Q.APP_AGGREGATE_MEAN_FRAC_BITS */
+	uint64_t m2_q;  /* sum of squared deviations, Q.(2 * APP_AGGREGATE_MEAN_FRAC_BITS) */
+	int32_t min;
+	int32_t max;
+	uint32_t n;
+};
+
+void app_aggregate_reset(struct app_aggregate *agg);
+void app_aggregate_add(struct app_aggregate *agg, int32_t value);
+
+/** Sample variance, over n - 1, in Q.(2 * APP_AGGREGATE_MEAN_FRAC_BITS); 0 below 2 readings */
+uint64_t app_aggregate_variance_q(const struct app_aggregate *agg);
+
+#endif /* __APP_AGGREGATE_H__ */
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <zcbor_encode.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+#ifdef CONFIG_DATE_TIME
+#include <date_time.h>
+#endif
+
+#include "app_batch.h"
+
+/*
+ * A batch is a CBOR array of {"ts": <unix ms>, "sensor": <sample>} maps. Before the device
+ * knows the time of day "ts" is replaced by "age", the milliseconds between taking the sample
+ * and building the request, which the cloud can subtract from the time it arrived. Samples are
+ * already CBOR encoded when they are batched, so the containers are framed by hand
+ * around them instead of the samples being re-encoded.
+ */
+
+/// Stream path for batches of samples in the given encoding
+///
+/// Standard batches are handled by pipelines/cbor-batch-to-lightdb.yml and compact batches by
+/// the board specific pipelines/cbor-compact-*.yml.
+const char *app_batch_stream_path(enum app_batch_format format)
+{
+	return (format == APP_BATCH_FORMAT_COMPACT) ? "batch_compact" : "batch";
+}
+
+/// Stream path for window summaries in the given encoding
+///
+/// Compact summaries are handled by the board specific pipelines/cbor-summary-compact-*.yml.
+const char *app_batch_summary_path(enum app_batch_format format)
+{
+	return (format == APP_BATCH_FORMAT_COMPACT) ? "summary_compact" : "summary";
+}
+
+/// Convert an uptime captured during this boot to Unix time
+///
+/// @param uptime_ms Value of k_uptime_get() when the sample was taken
+///
+/// @retval Unix time in milliseconds, or -1 if wall clock time is not known
+int64_t app_batch_uptime_to_unix_ms(int64_t uptime_ms)
+{
+#ifdef CONFIG_DATE_TIME
+	if (date_time_uptime_to_unix_time_ms(&uptime_ms) == 0) {
+		return uptime_ms;
+	}
+#endif
+
+	return -1;
+}
+
+/// Encode the map header and keys that precede one sample in a batch
+///
+/// @param buf     Output buffer
+/// @param buf_len Size of the output buffer
+/// @param unix_ms Sample timestamp; negative if not known
+/// @param age_ms  Time since the sample was taken, used without @p unix_ms; negative if not
+///                known either, to let the cloud timestamp the sample
+///
+/// @retval Number of bytes written or -ENOSPC
+int app_batch_put_entry_hdr(uint8_t *buf, size_t buf_len, int64_t unix_ms, int64_t age_ms)
+{
+	bool has_ts = (unix_ms >= 0);
+	bool has_age = !has_ts && (age_ms >= 0);
+	bool ok = true;
+
+	if (buf_len < 1) {
+		return -ENOSPC;
+	}
+
+	/* Definite length map header: major type 5 */
+	buf[0] = 0xa0 | ((has_ts || has_age) ? 2 : 1);
+
+	ZCBOR_STATE_E(zse, 0, &buf[1], buf_len - 1, 1);
+
+	if (has_ts) {
+		ok = zcbor_tstr_put_lit(zse, "ts") && zcbor_uint64_put(zse, unix_ms);
+	} else if (has_age) {
+		/* Capped to 32 bits to stay within APP_BATCH_ENTRY_HDR_MAX_LEN */
+		ok = zcbor_tstr_put_lit(zse, "age") &&
+		     zcbor_uint32_put(zse, (uint32_t) MIN(age_ms, UINT32_MAX));
+	}
+
+	if (!ok) {
+		return -ENOSPC;
+	}
+
+	ok = zcbor_tstr_put_lit(zse, "sensor");
+	if (!ok) {
+		return -ENOSPC;
+	}
+
+	return zse->payload - buf;
+}
+
+/// Write the array header into the APP_BATCH_ARRAY_HDR_LEN bytes reserved at the start of a batch
+void app_batch_put_array_hdr(uint8_t *buf, uint16_t count)
+{
+	/* Definite length array header with a 16-bit count: major type 4 */
+	buf[0] = 0x99;
+	sys_put_be16(count, &buf[1]);
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __APP_BATCH_H__
+#define __APP_BATCH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Sample encodings; each is uploaded on its own stream path so a pipeline can expand it */
+enum app_batch_format {
+	APP_BATCH_FORMAT_STANDARD,
+	APP_BATCH_FORMAT_COMPACT,
+};
+
+/* Bytes reserved at the start of a batch for the array header */
+#define APP_BATCH_ARRAY_HDR_LEN 3
+
+/* Worst case size of the {"ts" or "age": ..., "sensor": ...} wrapper around one sample */
+#define APP_BATCH_ENTRY_HDR_MAX_LEN 20
+
+const char *app_batch_stream_path(enum app_batch_format format);
+const char *app_batch_summary_path(enum app_batch_format format);
+int64_t app_batch_uptime_to_unix_ms(int64_t uptime_ms);
+int app_batch_put_entry_hdr(uint8_t *buf, size_t buf_len, int64_t unix_ms, int64_t age_ms);
+void app_batch_put_array_hdr(uint8_t *buf, uint16_t count);
+
+#endif /* __APP_BATCH_H__ */
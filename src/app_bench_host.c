@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Built into the native_sim runner rather than the Zephyr image, so this runs on the host and
+ * can see how much CPU time the simulated code really took.
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+uint64_t app_bench_host_cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
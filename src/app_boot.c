@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(app_boot, LOG_LEVEL_DBG);
+
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+#include "app_boot.h"
+
+static const char *const phase_names[APP_BOOT_PHASE_COUNT] = {
+	[APP_BOOT_KERNEL] = "kernel",
+	[APP_BOOT_MODEM] = "modem",
+	[APP_BOOT_NETWORK] = "network",
+	[APP_BOOT_DTLS] = "DTLS",
+	[APP_BOOT_FIRST_SAMPLE] = "first sample",
+	[APP_BOOT_FIRST_ACK] = "first ack",
+};
+
+/* Zero means "not reached", so a phase reached in the very first millisecond is stored as 1 */
+static atomic_t phase_ms[APP_BOOT_PHASE_COUNT];
+
+void app_boot_mark(enum app_boot_phase phase)
+{
+	uint32_t now_ms = MAX(k_uptime_get_32(), 1);
+	uint32_t ms[APP_BOOT_PHASE_COUNT];
+
+	if (!atomic_cas(&phase_ms[phase], 0, now_ms)) {
+		return;
+	}
+
+	LOG_DBG("Boot phase %s reached at %u ms", phase_names[phase], now_ms);
+
+	if (phase != APP_BOOT_FIRST_ACK) {
+		return;
+	}
+
+	/* Goes out with the log uplink too, so every boot is reported */
+	app_boot_get(ms);
+	LOG_INF("Boot: kernel %u, modem %u, network %u, DTLS %u, first sample %u, first ack %u ms",
+		ms[APP_BOOT_KERNEL], ms[APP_BOOT_MODEM], ms[APP_BOOT_NETWORK], ms[APP_BOOT_DTLS],
+		ms[APP_BOOT_FIRST_SAMPLE], ms[APP_BOOT_FIRST_ACK]);
+}
+
+void app_boot_get(uint32_t ms[APP_BOOT_PHASE_COUNT])
+{
+	for (int i = 0; i < APP_BOOT_PHASE_COUNT; i++) {
+		ms[i] = (uint32_t) atomic_get(&phase_ms[i]);
+	}
+}
+
+static int boot_kernel_up(void)
+{
+	app_boot_mark(APP_BOOT_KERNEL);
+	return 0;
+}
+
+SYS_INIT(boot_kernel_up, POST_KERNEL, 99);
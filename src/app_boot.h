@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __APP_BOOT_H__
+#define __APP_BOOT_H__
+
+#include <stdint.h>
+
+/* Milestones from reset to the first acknowledged uplink, in the order they are expected */
+enum app_boot_phase {
+	APP_BOOT_KERNEL,       /* kernel services up, before the application starts */
+	APP_BOOT_MODEM,        /* modem firmware version read */
+	APP_BOOT_NETWORK,      /* registered to LTE, or the network connected */
+	APP_BOOT_DTLS,         /* Golioth client connected */
+	APP_BOOT_FIRST_SAMPLE, /* first sensor reading handled */
+	APP_BOOT_FIRST_ACK,    /* first sensor or state uplink acknowledged */
+	APP_BOOT_PHASE_COUNT
+};
+
+/**
+ * Record the uptime at which @p phase was first reached
+ *
+ * Later calls for the same phase are ignored, so this can be called wherever the milestone may
+ * happen, from any thread. Once the first uplink is acknowledged all phases are logged together.
+ */
+void app_boot_mark(enum app_boot_phase phase);
+
+/* Uptime in ms at which each phase was reached since boot; 0 if it has not been yet */
+void app_boot_get(uint32_t ms[APP_BOOT_PHASE_COUNT]);
+
+#endif /* __APP_BOOT_H__ */
@@ -9,14 +9,15 @@
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(app_buzzer, LOG_LEVEL_DBG);
 
-#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
 #include <zephyr/device.h>
 #include <zephyr/drivers/pwm.h>
 #include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/util.h>
 
-#define FUNKYTOWN_NOTES 13
-#define MARIO_NOTES	37
-#define GOLIOTH_NOTES	21
+#include "app_buzzer.h"
 
 #define BUZZER_MAX_FREQ 2500
 #define BUZZER_MIN_FREQ 75
@@ -68,21 +69,10 @@ LOG_MODULE_REGISTER(app_buzzer, LOG_LEVEL_DBG);
 
 static const struct pwm_dt_spec sBuzzer = PWM_DT_SPEC_GET(DT_ALIAS(buzzer_pwm));
 
-enum song_choice {
-	beep,
-	funkytown,
-	mario,
-	golioth
-};
-
-enum song_choice song = 3;
+static const struct note_duration beep_song[] = {
+	{.note = 1000, .duration = 100}};
 
-struct note_duration {
-	int note;     /* hz */
-	int duration; /* msec */
-};
-
-static struct note_duration funkytown_song[FUNKYTOWN_NOTES] = {
+static const struct note_duration funkytown_song[] = {
 	{.note = C5, .duration = quarter},
 	{.note = REST, .duration = eigth},
 	{.note = C5, .duration = quarter},
@@ -97,7 +87,7 @@ static struct note_duration funkytown_song[FUNKYTOWN_NOTES] = {
 	{.note = E5, .duration = quarter},
 	{.note = C5, .duration = quarter}};
 
-static struct note_duration mario_song[MARIO_NOTES] = {
+static const struct note_duration mario_song[] = {
 	{.note = E6, .duration = quarter},
 	{.note = REST, .duration = eigth},
 	{.note = E6, .duration = quarter},
@@ -136,7 +126,7 @@ static struct note_duration mario_song[MARIO_NOTES] = {
 	{.note = D6, .duration = quarter},
 	{.note = B5, .duration = quarter}};
 
-static struct note_duration golioth_song[] = {
+static const struct note_duration golioth_song[] = {
 	{.note = C6, .duration = quarter},
 	{.note = REST, .duration = 100},
 	{.note = G5, .duration = 100},
@@ -151,77 +141,339 @@ static struct note_duration golioth_song[] = {
 	{.note = C6, .duration = quarter}
 };
 
-/* Thread plays song on buzzer */
+/*
+ * Songs are played by a work item on the system work queue that sets the buzzer for one note and
+ * reschedules itself for when the note ends, so nothing blocks while a note sounds. Requests wait
+ * in a bounded queue ordered by priority. A request of higher priority than the song playing
+ * starts at once; the interrupted song goes back to the head of the queue and resumes where it
+ * stopped.
+ */
+
+struct buzzer_request {
+	const struct note_duration *notes;
+	uint16_t count;
+	uint16_t index; /* next note to play */
+	enum app_buzzer_priority priority;
+};
+
+static struct k_spinlock lock;
+static struct buzzer_request queue[CONFIG_APP_BUZZER_QUEUE_DEPTH];
+static size_t queue_len;
+static struct buzzer_request current;
+static bool playing;
+static bool buzzer_ready;
+
+/* Notes of the last RTTTL tune; replaced by the next one */
+static struct note_duration rtttl_notes[CONFIG_APP_BUZZER_RTTTL_MAX_NOTES];
+
+static void step_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(step_work, step_work_handler);
+
+/* Caller holds lock. With @p ahead, go before requests of the same priority. */
+static int queue_insert(const struct buzzer_request *req, bool ahead)
+{
+	size_t pos = queue_len;
+
+	if (queue_len == ARRAY_SIZE(queue)) {
+		return -ENOBUFS;
+	}
+
+	while ((pos > 0) && ((queue[pos - 1].priority < req->priority) ||
+			     (ahead && (queue[pos - 1].priority == req->priority)))) {
+		queue[pos] = queue[pos - 1];
+		pos--;
+	}
+
+	queue[pos] = *req;
+	queue_len++;
+
+	return 0;
+}
+
+/* Caller holds lock */
+static bool queue_pop(struct buzzer_request *req)
+{
+	if (queue_len == 0) {
+		return false;
+	}
+
+	*req = queue[0];
+	queue_len--;
+	memmove(&queue[0], &queue[1], queue_len * sizeof(queue[0]));
+
+	return true;
+}
+
+static void buzzer_tone(int note)
+{
+	if (note < 10) {
+		/* Low frequency notes represent a 'pause' */
+		pwm_set_pulse_dt(&sBuzzer, 0);
+	} else {
+		pwm_set_dt(&sBuzzer, PWM_HZ(note), PWM_HZ(note) / 2);
+	}
+}
+
+static void step_work_handler(struct k_work *work)
+{
+	struct note_duration note;
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	if (playing && (current.index >= current.count)) {
+		playing = false;
+	}
+
+	/* Never start a request that has no notes left, whatever put it in the queue */
+	while (!playing && queue_pop(&current)) {
+		playing = (current.index < current.count);
+	}
 
-K_SEM_DEFINE(buzzer_initialized_sem, 0, 1); /* Wait until buzzer is ready */
+	if (!playing) {
+		k_spin_unlock(&lock, key);
+
+		/* turn buzzer off (pulse duty to 0) */
+		pwm_set_pulse_dt(&sBuzzer, 0);
+		return;
+	}
 
-#define BUZZER_STACK 1024
+	note = current.notes[current.index++];
+	k_spin_unlock(&lock, key);
 
-extern void buzzer_thread(void *d0, void *d1, void *d2)
+	buzzer_tone(note.note);
+
+	/* Does nothing if a preempting request already asked for the next step now */
+	k_work_schedule(&step_work, K_MSEC(note.duration));
+}
+
+int app_buzzer_play(const struct note_duration *notes, size_t count,
+		    enum app_buzzer_priority priority)
 {
-	/* Block until buzzer is available */
-	k_sem_take(&buzzer_initialized_sem, K_FOREVER);
-	while (1) {
-		switch (song) {
-		case 0:
-			LOG_DBG("beep");
-			pwm_set_dt(&sBuzzer, PWM_HZ(1000), PWM_HZ(1000) / 2);
-			k_msleep(100);
+	struct buzzer_request req = {
+		.notes = notes,
+		.count = count,
+		.priority = priority,
+	};
+	bool start_now = false;
+	int err = 0;
+
+	if ((count == 0) || (count > UINT16_MAX)) {
+		return -EINVAL;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	if (!playing) {
+		err = queue_insert(&req, false);
+		start_now = true;
+	} else if (priority > current.priority) {
+		/* Resume the interrupted song later, unless its last note is already playing; drop
+		 * it only if the queue is full
+		 */
+		if ((current.index < current.count) && queue_insert(&current, true)) {
+			LOG_WRN("Buzzer queue full, dropping interrupted song");
+		}
+		current = req;
+		start_now = true;
+	} else {
+		err = queue_insert(&req, false);
+	}
+
+	k_spin_unlock(&lock, key);
+
+	if (err) {
+		LOG_WRN("Buzzer queue full, dropping request");
+		return err;
+	}
+
+	if (start_now && buzzer_ready) {
+		k_work_reschedule(&step_work, K_NO_WAIT);
+	}
+
+	return 0;
+}
+
+/* Octave 4; other octaves are shifted from these */
+static const uint16_t rtttl_octave4_hz[] = {C4, Db4, D4, Eb4, E4, F4, Gb4, G4, Ab4, A4, Bb4, B4};
+
+/* Semitone of each note letter from 'a' to 'g' */
+static const uint8_t rtttl_semitone[] = {9, 11, 0, 2, 4, 5, 7};
+
+/* Leaves @p value alone if there is no number here */
+static bool rtttl_number(const char **p, const char *end, int *value)
+{
+	const char *start = *p;
+	int parsed = 0;
+
+	while ((*p < end) && (**p >= '0') && (**p <= '9') && (parsed < 100000)) {
+		parsed = (parsed * 10) + (**p - '0');
+		(*p)++;
+	}
+
+	if (*p == start) {
+		return false;
+	}
+
+	*value = parsed;
+	return true;
+}
+
+static bool rtttl_char(const char **p, const char *end, char c)
+{
+	if ((*p < end) && (**p == c)) {
+		(*p)++;
+		return true;
+	}
+
+	return false;
+}
+
+/// Parse an RTTTL tune such as "name:d=4,o=5,b=120:8c,8d,e.,p,c6"
+///
+/// @param notes Output, or NULL to only validate and count
+///
+/// @return Number of notes, or a negative error code
+static int rtttl_parse(const char *p, size_t len, struct note_duration *notes, size_t max)
+{
+	const char *end = p + len;
+	int def_duration = 4;
+	int def_octave = 6;
+	int bpm = 63;
+	size_t count = 0;
+
+	/* Skip the name */
+	while ((p < end) && (*p != ':')) {
+		p++;
+	}
+	if (!rtttl_char(&p, end, ':')) {
+		return -EINVAL;
+	}
+
+	while ((p < end) && (*p != ':')) {
+		char key = *p++;
+		int value;
+
+		if (!rtttl_char(&p, end, '=') || !rtttl_number(&p, end, &value)) {
+			return -EINVAL;
+		}
+
+		switch (key) {
+		case 'd':
+			def_duration = value;
 			break;
-		case 1:
-			LOG_DBG("funkytown");
-			for (int i = 0; i < FUNKYTOWN_NOTES; i++) {
-				if (funkytown_song[i].note < 10) {
-					/* Low frequency notes represent a 'pause' */
-					pwm_set_pulse_dt(&sBuzzer, 0);
-					k_msleep(funkytown_song[i].duration);
-				} else {
-					pwm_set_dt(&sBuzzer, PWM_HZ(funkytown_song[i].note),
-						   PWM_HZ((funkytown_song[i].note)) / 2);
-					k_msleep(funkytown_song[i].duration);
-				}
-			}
+		case 'o':
+			def_octave = value;
 			break;
+		case 'b':
+			bpm = value;
+			break;
+		default:
+			return -EINVAL;
+		}
+
+		rtttl_char(&p, end, ',');
+	}
+	if (!rtttl_char(&p, end, ':') || (def_duration == 0) || (bpm == 0)) {
+		return -EINVAL;
+	}
+
+	int whole_ms = (60 * MSEC_PER_SEC * 4) / bpm;
+
+	while (p < end) {
+		int duration = def_duration;
+		int octave = def_octave;
+		int hz = REST;
+
+		while (rtttl_char(&p, end, ' ')) {
+		}
 
-		case 2:
-			LOG_DBG("mario");
-			for (int i = 0; i < MARIO_NOTES; i++) {
-				if (mario_song[i].note < 10) {
-					/* Low frequency notes represent a 'pause' */
-					pwm_set_pulse_dt(&sBuzzer, 0);
-					k_msleep(mario_song[i].duration);
-				} else {
-					pwm_set_dt(&sBuzzer, PWM_HZ(mario_song[i].note),
-						   PWM_HZ((mario_song[i].note)) / 2);
-					k_msleep(mario_song[i].duration);
-				}
+		rtttl_number(&p, end, &duration);
+		if ((duration == 0) || (p == end)) {
+			return -EINVAL;
+		}
+
+		char letter = *p++ | 0x20; /* lower case */
+
+		if ((letter >= 'a') && (letter <= 'g')) {
+			int semitone = rtttl_semitone[letter - 'a'] + rtttl_char(&p, end, '#');
+			bool dotted = rtttl_char(&p, end, '.');
+
+			if ((p < end) && (*p >= '0') && (*p <= '9')) {
+				octave = *p++ - '0';
 			}
-			break;
-		case 3:
-			LOG_DBG("golioth");
-			for (int i = 0; i < (sizeof(golioth_song) / sizeof(golioth_song[1])); i++) {
-				if (golioth_song[i].note < 10) {
-					/* Low frequency notes represent a 'pause' */
-					pwm_set_pulse_dt(&sBuzzer, 0);
-					k_msleep(golioth_song[i].duration);
-				} else {
-					pwm_set_dt(&sBuzzer, PWM_HZ(golioth_song[i].note),
-						   PWM_HZ((golioth_song[i].note)) / 2);
-					k_msleep(golioth_song[i].duration);
-				}
+			dotted |= rtttl_char(&p, end, '.');
+
+			/* B# is the C of the next octave */
+			hz = (semitone < 12) ? rtttl_octave4_hz[semitone] : (C4 * 2);
+			hz = (octave >= 4) ? (hz << MIN(octave - 4, 8)) : (hz >> (4 - octave));
+
+			/* Keep the tune, an octave at a time, within what the buzzer can play */
+			while (hz > BUZZER_MAX_FREQ) {
+				hz /= 2;
 			}
-			break;
-		default:
-			LOG_WRN("invalid switch state");
-			break;
+			while (hz < BUZZER_MIN_FREQ) {
+				hz *= 2;
+			}
+
+			duration = (whole_ms / duration) * (dotted ? 3 : 2) / 2;
+		} else if (letter == 'p') {
+			bool dotted = rtttl_char(&p, end, '.');
+
+			duration = (whole_ms / duration) * (dotted ? 3 : 2) / 2;
+		} else {
+			return -EINVAL;
 		}
 
-		/* turn buzzer off (pulse duty to 0) */
-		pwm_set_pulse_dt(&sBuzzer, 0);
+		if (count == max) {
+			return -E2BIG;
+		}
+
+		if (notes) {
+			notes[count] = (struct note_duration){.note = hz, .duration = duration};
+		}
+		count++;
+
+		while (rtttl_char(&p, end, ' ')) {
+		}
+		if ((p < end) && !rtttl_char(&p, end, ',')) {
+			return -EINVAL;
+		}
+	}
+
+	return (count > 0) ? (int) count : -EINVAL;
+}
 
-		/* Sleep thread until awoken externally */
-		k_sleep(K_FOREVER);
+int app_buzzer_play_rtttl(const char *rtttl, size_t len)
+{
+	/* Validate before touching the notes of a tune that may be playing */
+	int count = rtttl_parse(rtttl, len, NULL, ARRAY_SIZE(rtttl_notes));
+
+	if (count < 0) {
+		return count;
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	/* Nothing may refer to the old tune once it is overwritten */
+	for (size_t i = 0; i < queue_len;) {
+		if (queue[i].notes == rtttl_notes) {
+			queue_len--;
+			memmove(&queue[i], &queue[i + 1], (queue_len - i) * sizeof(queue[0]));
+		} else {
+			i++;
+		}
+	}
+
+	if (playing && (current.notes == rtttl_notes)) {
+		current.index = current.count;
 	}
+
+	k_spin_unlock(&lock, key);
+
+	rtttl_parse(rtttl, len, rtttl_notes, ARRAY_SIZE(rtttl_notes));
+
+	int err = app_buzzer_play(rtttl_notes, count, APP_BUZZER_PRIO_SONG);
+
+	return err ? err : count;
 }
 
 int app_buzzer_init(void)
@@ -229,35 +481,33 @@ int app_buzzer_init(void)
 	if (!device_is_ready(sBuzzer.dev)) {
 		return -ENODEV;
 	}
-	k_sem_give(&buzzer_initialized_sem);
+
+	buzzer_ready = true;
+
+	/* Announce boot; this also starts anything requested before now */
+	app_buzzer_play(golioth_song, ARRAY_SIZE(golioth_song), APP_BUZZER_PRIO_SONG);
+
 	return 0;
 }
 
-K_THREAD_DEFINE(buzzer_tid, BUZZER_STACK, buzzer_thread, NULL, NULL, NULL,
-		K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
-
 void play_beep_once(void)
 {
-	song = beep;
-	k_wakeup(buzzer_tid);
+	app_buzzer_play(beep_song, ARRAY_SIZE(beep_song), APP_BUZZER_PRIO_ALERT);
 }
 
 void play_funkytown_once(void)
 {
-	song = funkytown;
-	k_wakeup(buzzer_tid);
+	app_buzzer_play(funkytown_song, ARRAY_SIZE(funkytown_song), APP_BUZZER_PRIO_SONG);
 }
 
 void play_mario_once(void)
 {
-	song = mario;
-	k_wakeup(buzzer_tid);
+	app_buzzer_play(mario_song, ARRAY_SIZE(mario_song), APP_BUZZER_PRIO_SONG);
 }
 
 void play_golioth_once(void)
 {
-	song = golioth;
-	k_wakeup(buzzer_tid);
+	app_buzzer_play(golioth_song, ARRAY_SIZE(golioth_song), APP_BUZZER_PRIO_SONG);
 }
 
 #else
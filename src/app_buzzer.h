@@ -7,10 +7,43 @@
 #ifndef __APP_BUZZER_H__
 #define __APP_BUZZER_H__
 
+#include <stddef.h>
+
 int app_buzzer_init(void);
 void play_beep_once(void);
 
 #if defined(CONFIG_BOARD_THINGY91_NRF9160_NS)
+
+struct note_duration {
+	int note;     /* hz */
+	int duration; /* msec */
+};
+
+/* A request of higher priority interrupts the song playing, which resumes afterwards */
+enum app_buzzer_priority {
+	APP_BUZZER_PRIO_SONG,
+	APP_BUZZER_PRIO_ALERT,
+};
+
+/**
+ * Queue a song; safe to call from an ISR
+ *
+ * @p notes must stay valid until the song has played.
+ *
+ * @retval 0 Song queued or playing
+ * @retval -ENOBUFS CONFIG_APP_BUZZER_QUEUE_DEPTH songs are already waiting
+ */
+int app_buzzer_play(const struct note_duration *notes, size_t count,
+		    enum app_buzzer_priority priority);
+
+/**
+ * Queue a tune in RTTTL format, replacing any RTTTL tune queued or playing
+ *
+ * @return Number of notes queued, -EINVAL if the tune does not parse, -E2BIG if it has more
+ *         than CONFIG_APP_BUZZER_RTTTL_MAX_NOTES notes, or -ENOBUFS if the queue is full
+ */
+int app_buzzer_play_rtttl(const char *rtttl, size_t len);
+
 void play_funkytown_once(void);
 void play_mario_once(void);
 void play_golioth_once(void);
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <zephyr/sys/util.h>
+
+#include "app_fixed.h"
+
+/* micro / 10^6 == (micro * MICRO_RECIP) / 2^MICRO_RECIP_SHIFT, to 2^-64 relative error */
+#define MICRO_RECIP	  0x8637bd05af6c69b6ULL
+#define MICRO_RECIP_SHIFT 83
+
+/* 128 bit product from 32 bit multiplies, which the Cortex-M33 does in one cycle each */
+static void mul_64x64(uint64_t a, uint64_t b, uint64_t *hi, uint64_t *lo)
+{
+	uint64_t ll = (uint64_t) (uint32_t) a * (uint32_t) b;
+	uint64_t lh = (uint64_t) (uint32_t) a * (uint32_t) (b >> 32);
+	uint64_t hl = (uint64_t) (uint32_t) (a >> 32) * (uint32_t) b;
+	uint64_t hh = (uint64_t) (uint32_t) (a >> 32) * (uint32_t) (b >> 32);
+	uint64_t mid = (ll >> 32) + (uint32_t) lh + (uint32_t) hl;
+
+	*lo = (mid << 32) | (uint32_t) ll;
+	*hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+}
+
+/* Pack micro / 10^6 as a binary floating point number; sensor values never need subnormals,
+ * infinities or NaN in either format.
+ */
+static uint64_t micro_to_ieee(int64_t micro, unsigned int frac_bits, unsigned int exp_bits)
+{
+	uint64_t sign = (micro < 0) ? 1 : 0;
+	uint64_t n = sign ? -(uint64_t) micro : (uint64_t) micro;
+	int bias = (1 << (exp_bits - 1)) - 1;
+	uint64_t hi, lo, m;
+	bool sticky;
+	int top, shift, exp;
+
+	if (n == 0) {
+		return sign << (frac_bits + exp_bits);
+	}
+
+	mul_64x64(n, MICRO_RECIP, &hi, &lo);
+
+	/* MICRO_RECIP >= 2^63, so the leading one is at bit 63 or above */
+	top = hi ? (127 - __builtin_clzll(hi)) : 63;
+
+	/* Keep the significand plus one rounding bit; everything below only matters as sticky */
+	shift = top - (int) (frac_bits + 1);
+	if (shift >= 64) {
+		m = hi >> (shift - 64);
+		sticky = (lo != 0) || ((hi & (BIT64(shift - 64) - 1)) != 0);
+	} else {
+		m = (hi << (64 - shift)) | (lo >> shift);
+		sticky = (lo & (BIT64(shift) - 1)) != 0;
+	}
+
+	/* Round half to even */
+	bool round = m & 1;
+
+	m >>= 1;
+	if (round && (sticky || (m & 1))) {
+		m++;
+	}
+
+	exp = top - MICRO_RECIP_SHIFT;
+	if (m >> (frac_bits + 1)) {
+		m >>= 1;
+		exp++;
+	}
+
+	return (sign << (frac_bits + exp_bits)) | ((uint64_t) (exp + bias) << frac_bits) |
+	       (m & (BIT64(frac_bits) - 1));
+}
+
+uint64_t app_fixed_micro_to_f64(int64_t micro)
+{
+	return micro_to_ieee(micro, 52, 11);
+}
+
+uint32_t app_fixed_micro_to_f32(int64_t micro)
+{
+	return (uint32_t) micro_to_ieee(micro, 23, 8);
+}
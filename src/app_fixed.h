@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __APP_FIXED_H__
+#define __APP_FIXED_H__
+
+#include <stdint.h>
+
+/*
+ * Sensor readings stay in fixed point, as struct sensor_value or as millionths of the unit from
+ * sensor_value_to_micro(), from the driver to the encoder. These helpers produce the IEEE 754
+ * bit patterns the encoder writes with integer arithmetic only, so no float or double math runs
+ * per sample; the Cortex-M33 FPU is single precision and emulates double in software.
+ */
+
+/**
+ * Binary64 bits of micro / 1000000
+ *
+ * Rounded to nearest; a value that lies within 2^-64 of a halfway point may round either way.
+ */
+uint64_t app_fixed_micro_to_f64(int64_t micro);
+
+/** Binary32 bits of micro / 1000000, rounded as app_fixed_micro_to_f64() */
+uint32_t app_fixed_micro_to_f32(int64_t micro);
+
+#endif /* __APP_FIXED_H__ */
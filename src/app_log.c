@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(app_log, LOG_LEVEL_DBG);
+
+#include <string.h>
+#include <golioth/client.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log_backend.h>
+#include <zephyr/logging/log_ctrl.h>
+#include <zephyr/sys/atomic.h>
+
+#ifdef CONFIG_APP_LOG_UPLINK_DICTIONARY
+#include <golioth/stream.h>
+#include <zcbor_encode.h>
+#include <zephyr/logging/log_output.h>
+#include <zephyr/logging/log_output_dict.h>
+#endif
+
+#include "app_log.h"
+
+/*
+ * Token bucket in units of milliseconds times messages per minute: a message costs one minute
+ * and every elapsed millisecond adds RATE units, which keeps the refill exact in integers.
+ */
+#define RATE		   CONFIG_APP_LOG_UPLINK_RATE_PER_MIN
+#define TOKEN_COST	   (60 * MSEC_PER_SEC)
+#define BUCKET_CAPACITY	   ((int64_t) CONFIG_APP_LOG_UPLINK_BURST * TOKEN_COST)
+#define GOLIOTH_BACKEND	   "log_backend_golioth"
+
+static const struct log_backend *golioth_backend;
+static int64_t bucket;
+static int64_t bucket_updated_ms;
+static uint32_t held_back; /* dropped since the last message that got through */
+static atomic_t forwarded;
+static atomic_t dropped;
+
+static bool take_token(void)
+{
+	int64_t now = k_uptime_get();
+
+	bucket = MIN(bucket + ((now - bucket_updated_ms) * RATE), BUCKET_CAPACITY);
+	bucket_updated_ms = now;
+
+	if (bucket < TOKEN_COST) {
+		return false;
+	}
+
+	bucket -= TOKEN_COST;
+	return true;
+}
+
+#ifdef CONFIG_APP_LOG_UPLINK_DICTIONARY
+
+#define DICT_BUF_SIZE CONFIG_APP_LOG_UPLINK_DICT_BUF_SIZE
+
+static struct golioth_client *client;
+static uint8_t dict_buf[DICT_BUF_SIZE];
+static size_t dict_len;
+static size_t record_start;    /* offset in dict_buf of the record being written */
+static bool record_discarded; /* the record being written can never fit in dict_buf */
+static K_MUTEX_DEFINE(dict_mutex);
+
+static void dict_flush_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(dict_flush_work, dict_flush_work_handler);
+
+static void async_error_handler(struct golioth_client *client, enum golioth_status status,
+				const struct golioth_coap_rsp_code *coap_rsp_code, const char *path,
+				void *arg)
+{
+	if (status != GOLIOTH_OK) {
+		/* Logged records would come straight back here; count them instead */
+		atomic_inc(&dropped);
+	}
+}
+
+/* Called with dict_mutex held */
+static void dict_flush(void)
+{
+	/* Byte string header plus the map around it */
+	static uint8_t cbor_buf[DICT_BUF_SIZE + 16];
+	ZCBOR_STATE_E(zse, 1, cbor_buf, sizeof(cbor_buf), 1);
+	bool ok;
+
+	if (dict_len == 0) {
+		return;
+	}
+
+	ok = zcbor_map_start_encode(zse, 1) && zcbor_tstr_put_lit(zse, "d") &&
+	     zcbor_bstr_encode_ptr(zse, (const char *) dict_buf, dict_len) &&
+	     zcbor_map_end_encode(zse, 1);
+
+	if (!ok || !golioth_client_is_connected(client) ||
+	    golioth_stream_set_async(client, "log", GOLIOTH_CONTENT_TYPE_CBOR, cbor_buf,
+				     zse->payload - cbor_buf, async_error_handler, NULL)) {
+		atomic_inc(&dropped);
+	}
+
+	dict_len = 0;
+	record_start = 0;
+}
+
+static void dict_flush_work_handler(struct k_work *work)
+{
+	k_mutex_lock(&dict_mutex, K_FOREVER);
+	dict_flush();
+	k_mutex_unlock(&dict_mutex);
+}
+
+/* Records arrive in pieces; called with dict_mutex held by output_msg() */
+static int dict_out(uint8_t *data, size_t length, void *ctx)
+{
+	size_t partial = dict_len - record_start;
+
+	if (record_discarded) {
+		return length;
+	}
+
+	if ((partial + length) > sizeof(dict_buf)) {
+		/* A truncated record cannot be decoded; drop it whole */
+		dict_len = record_start;
+		record_discarded = true;
+		atomic_inc(&dropped);
+		return length;
+	}
+
+	if ((dict_len + length) > sizeof(dict_buf)) {
+		/* Send the complete records and carry over the start of this one */
+		dict_len = record_start;
+		dict_flush();
+		memmove(dict_buf, &dict_buf[record_start], partial);
+		dict_len = partial;
+		record_start = 0;
+	}
+
+	memcpy(&dict_buf[dict_len], data, length);
+	dict_len += length;
+
+	/* Bounds how long a record waits; a pending flush is not pushed back */
+	k_work_schedule(&dict_flush_work, K_SECONDS(CONFIG_APP_LOG_UPLINK_DICT_FLUSH_S));
+
+	return length;
+}
+
+static uint8_t dict_output_buf[64];
+LOG_OUTPUT_DEFINE(dict_output, dict_out, dict_output_buf, sizeof(dict_output_buf));
+
+static void begin_record(void)
+{
+	record_start = dict_len;
+	record_discarded = false;
+}
+
+static void output_msg(union log_msg_generic *msg)
+{
+	/* Held for whole records so a timed flush never sends part of one */
+	k_mutex_lock(&dict_mutex, K_FOREVER);
+
+	if (held_back) {
+		begin_record();
+		log_dict_output_dropped_process(&dict_output, held_back);
+	}
+
+	begin_record();
+	log_dict_output_msg_process(&dict_output, &msg->log, 0);
+
+	record_start = dict_len;
+
+	k_mutex_unlock(&dict_mutex);
+}
+
+/* The SDK logs every request it sends; uploading those would feed back into itself */
+static void exclude_sdk_sources(const struct log_backend *backend)
+{
+	const char *name;
+
+	for (int source_id = 0; (name = log_source_name_get(0, source_id)) != NULL; source_id++) {
+		if (strncmp(name, "golioth", strlen("golioth")) == 0) {
+			log_filter_set(backend, 0, source_id, LOG_LEVEL_NONE);
+		}
+	}
+}
+
+#else
+
+static void output_msg(union log_msg_generic *msg)
+{
+	if (held_back && golioth_backend->api->dropped) {
+		golioth_backend->api->dropped(golioth_backend, held_back);
+	}
+
+	golioth_backend->api->process(golioth_backend, msg);
+}
+
+#endif /* CONFIG_APP_LOG_UPLINK_DICTIONARY */
+
+static void process(const struct log_backend *const backend, union log_msg_generic *msg)
+{
+	/* Keep the SDK backend out of the core's dispatch even if it re-enables itself */
+	if (golioth_backend && log_backend_is_active(golioth_backend)) {
+		log_backend_disable(golioth_backend);
+	}
+
+	/* Errors always get through; they still use up a token if there is one */
+	if (!take_token() && (log_msg_get_level(&msg->log) != LOG_LEVEL_ERR)) {
+		held_back++;
+		atomic_inc(&dropped);
+		return;
+	}
+
+	output_msg(msg);
+	held_back = 0;
+	atomic_inc(&forwarded);
+}
+
+static void dropped_cb(const struct log_backend *const backend, uint32_t cnt)
+{
+	held_back += cnt;
+	atomic_add(&dropped, cnt);
+}
+
+static void panic(const struct log_backend *const backend)
+{
+	/* Nothing can be sent over the network once the system has panicked */
+}
+
+static const struct log_backend_api uplink_api = {
+	.process = process,
+	.dropped = dropped_cb,
+	.panic = panic,
+};
+
+LOG_BACKEND_DEFINE(app_log_uplink, uplink_api, false);
+
+void app_log_uplink_get_stats(struct app_log_uplink_stats *stats)
+{
+	stats->forwarded = atomic_get(&forwarded);
+	stats->dropped = atomic_get(&dropped);
+}
+
+void app_log_uplink_init(struct golioth_client *uplink_client)
+{
+	golioth_backend = log_backend_get_by_name(GOLIOTH_BACKEND);
+
+#ifdef CONFIG_APP_LOG_UPLINK_DICTIONARY
+	client = uplink_client;
+#else
+	if (!golioth_backend) {
+		LOG_WRN("No %s to forward to, log uplink disabled", GOLIOTH_BACKEND);
+		return;
+	}
+#endif
+
+	if (golioth_backend) {
+		log_backend_disable(golioth_backend);
+	}
+
+	bucket = BUCKET_CAPACITY;
+	bucket_updated_ms = k_uptime_get();
+
+	log_backend_enable(&app_log_uplink, NULL, CONFIG_APP_LOG_UPLINK_LEVEL);
+
+#ifdef CONFIG_APP_LOG_UPLINK_DICTIONARY
+	exclude_sdk_sources(&app_log_uplink);
+#endif
+
+	LOG_INF("Log uplink limited to %d messages per minute, bursts of %d", RATE,
+		CONFIG_APP_LOG_UPLINK_BURST);
+}
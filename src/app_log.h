@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __APP_LOG_H__
+#define __APP_LOG_H__
+
+#include <stdint.h>
+#include <golioth/client.h>
+
+struct app_log_uplink_stats {
+	uint32_t forwarded; /* messages passed on to Golioth */
+	uint32_t dropped;   /* messages held back by the rate limit or a full buffer */
+};
+
+#ifdef CONFIG_APP_LOG_UPLINK
+
+/**
+ * Put the rate-limited uplink backend in front of the Golioth log backend
+ *
+ * Messages reach Golioth only through this backend from here on, starting at
+ * CONFIG_APP_LOG_UPLINK_LEVEL for every module.
+ */
+void app_log_uplink_init(struct golioth_client *client);
+void app_log_uplink_get_stats(struct app_log_uplink_stats *stats);
+
+#else
+
+static inline void app_log_uplink_init(struct golioth_client *client)
+{
+}
+
+static inline void app_log_uplink_get_stats(struct app_log_uplink_stats *stats)
+{
+	*stats = (struct app_log_uplink_stats){0};
+}
+
+#endif /* CONFIG_APP_LOG_UPLINK */
+
+#endif /* __APP_LOG_H__ */
@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(app_metrics, LOG_LEVEL_DBG);
+
+#include <golioth/client.h>
+#include <golioth/stream.h>
+#include <zcbor_encode.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net_buf.h>
+
+#if defined(CONFIG_MBEDTLS_ENABLE_HEAP) && defined(CONFIG_MBEDTLS_MEMORY_DEBUG)
+#include <mbedtls/memory_buffer_alloc.h>
+#define HAVE_TLS_HEAP_STATS 1
+#endif
+
+#include "app_boot.h"
+#include "app_log.h"
+#include "app_metrics.h"
+#include "app_radio.h"
+#include "app_sample_queue.h"
+#include "app_schedule.h"
+#include "app_sensors.h"
+#include "app_state.h"
+#include "app_uplink_buf.h"
+
+#define METRICS_STREAM_BUF_SIZE 1024
+
+struct thread_metrics {
+	const char *name;
+	uint32_t cpu_permille; /* share of all cycles since boot, idle thread included */
+	uint32_t stack_used;   /* high-water mark in bytes */
+	uint32_t stack_size;
+};
+
+struct thread_collection {
+	struct thread_metrics threads[CONFIG_APP_METRICS_MAX_THREADS];
+	size_t count;
+	uint64_t total_cycles;
+};
+
+static struct golioth_client *client;
+
+static void metrics_stream_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(metrics_stream_work, metrics_stream_work_handler);
+
+static void collect_thread(const struct k_thread *thread, void *user_data)
+{
+	struct thread_collection *c = user_data;
+	k_tid_t tid = (k_tid_t) thread;
+	k_thread_runtime_stats_t rt;
+	size_t unused = 0;
+
+	if (c->count == ARRAY_SIZE(c->threads)) {
+		return;
+	}
+
+	struct thread_metrics *m = &c->threads[c->count++];
+
+	m->name = k_thread_name_get(tid);
+	m->stack_size = thread->stack_info.size;
+
+	if ((k_thread_runtime_stats_get(tid, &rt) == 0) && (c->total_cycles > 0)) {
+		m->cpu_permille = (uint32_t) ((rt.execution_cycles * 1000) / c->total_cycles);
+	} else {
+		m->cpu_permille = 0;
+	}
+
+	/* Scans the stack for the fill pattern; runs without the thread list lock held */
+	if (k_thread_stack_space_get(thread, &unused) == 0) {
+		m->stack_used = m->stack_size - unused;
+	} else {
+		m->stack_used = 0;
+	}
+}
+
+static bool put_uint_list(zcbor_state_t *zse, const uint32_t *values, size_t count)
+{
+	bool ok = zcbor_list_start_encode(zse, count);
+
+	for (size_t i = 0; ok && (i < count); i++) {
+		ok = zcbor_uint32_put(zse, values[i]);
+	}
+
+	return ok && zcbor_list_end_encode(zse, count);
+}
+
+static bool put_int_list(zcbor_state_t *zse, const int32_t *values, size_t count)
+{
+	bool ok = zcbor_list_start_encode(zse, count);
+
+	for (size_t i = 0; ok && (i < count); i++) {
+		ok = zcbor_int32_put(zse, values[i]);
+	}
+
+	return ok && zcbor_list_end_encode(zse, count);
+}
+
+static bool put_uptime(zcbor_state_t *zse)
+{
+	return zcbor_uint32_put(zse, (uint32_t) (k_uptime_get() / MSEC_PER_SEC));
+}
+
+static bool put_threads(zcbor_state_t *zse)
+{
+	/* Too large for the stacks this can run on */
+	static struct thread_collection c;
+	k_thread_runtime_stats_t all;
+	bool ok;
+
+	c.count = 0;
+	c.total_cycles = 0;
+	if (k_thread_runtime_stats_all_get(&all) == 0) {
+		c.total_cycles = all.execution_cycles;
+	}
+
+	k_thread_foreach_unlocked(collect_thread, &c);
+
+	ok = zcbor_list_start_encode(zse, c.count);
+
+	for (size_t i = 0; ok && (i < c.count); i++) {
+		const struct thread_metrics *m = &c.threads[i];
+		const char *name = (m->name && m->name[0]) ? m->name : "?";
+
+		ok = zcbor_list_start_encode(zse, 4) &&
+		     zcbor_tstr_put_term(zse, name, CONFIG_THREAD_MAX_NAME_LEN) &&
+		     zcbor_uint32_put(zse, m->cpu_permille) &&
+		     zcbor_uint32_put(zse, m->stack_used) &&
+		     zcbor_uint32_put(zse, m->stack_size) &&
+		     zcbor_list_end_encode(zse, 4);
+	}
+
+	return ok && zcbor_list_end_encode(zse, c.count);
+}
+
+static bool put_loop(zcbor_state_t *zse)
+{
+	struct app_schedule_stats loop;
+
+	app_schedule_get_stats(&loop);
+
+	const int32_t loop_ms[] = {loop.cycle_last_ms, loop.cycle_max_ms, loop.cycle_avg_ms};
+
+	return put_int_list(zse, loop_ms, ARRAY_SIZE(loop_ms));
+}
+
+static bool put_jitter(zcbor_state_t *zse)
+{
+	struct app_schedule_stats loop;
+
+	app_schedule_get_stats(&loop);
+
+	const int32_t jitter_ms[] = {loop.jitter_last_ms, loop.jitter_max_ms, loop.jitter_avg_ms};
+
+	return put_int_list(zse, jitter_ms, ARRAY_SIZE(jitter_ms));
+}
+
+static bool put_overruns(zcbor_state_t *zse)
+{
+	struct app_schedule_stats loop;
+
+	app_schedule_get_stats(&loop);
+
+	const uint32_t overruns[] = {loop.overruns, loop.skipped};
+
+	return put_uint_list(zse, overruns, ARRAY_SIZE(overruns));
+}
+
+static bool put_cycles(zcbor_state_t *zse)
+{
+	struct app_schedule_stats loop;
+
+	app_schedule_get_stats(&loop);
+
+	const uint32_t cycles[] = {loop.cycles, loop.on_demand};
+
+	return put_uint_list(zse, cycles, ARRAY_SIZE(cycles));
+}
+
+static bool put_uplinks(zcbor_state_t *zse)
+{
+	struct app_sensors_uplink_stats uplink;
+
+	app_sensors_get_uplink_stats(&uplink);
+
+	const uint32_t uplinks[] = {uplink.sent, uplink.failed, uplink.queued, uplink.dropped};
+
+	return put_uint_list(zse, uplinks, ARRAY_SIZE(uplinks));
+}
+
+static bool put_queue(zcbor_state_t *zse)
+{
+	struct app_sample_queue_stats queue;
+
+	app_sample_queue_get_stats(&queue);
+
+	const uint32_t queued[] = {queue.pending, queue.dropped};
+
+	return put_uint_list(zse, queued, ARRAY_SIZE(queued));
+}
+
+static bool put_state_writes(zcbor_state_t *zse)
+{
+	struct app_state_write_stats state;
+
+	app_state_get_write_stats(&state);
+
+	const uint32_t writes[] = {state.sent, state.saved};
+
+	return put_uint_list(zse, writes, ARRAY_SIZE(writes));
+}
+
+static bool put_logs(zcbor_state_t *zse)
+{
+	struct app_log_uplink_stats log;
+
+	app_log_uplink_get_stats(&log);
+
+	const uint32_t logs[] = {log.forwarded, log.dropped};
+
+	return put_uint_list(zse, logs, ARRAY_SIZE(logs));
+}
+
+static bool put_bufs(zcbor_state_t *zse)
+{
+	struct app_uplink_buf_stats pool;
+
+	app_uplink_buf_get_stats(&pool);
+
+	const uint32_t bufs[] = {pool.used, pool.peak, pool.failed};
+
+	return put_uint_list(zse, bufs, ARRAY_SIZE(bufs));
+}
+
+static bool put_boot(zcbor_state_t *zse)
+{
+	uint32_t boot_ms[APP_BOOT_PHASE_COUNT];
+
+	app_boot_get(boot_ms);
+
+	return put_uint_list(zse, boot_ms, ARRAY_SIZE(boot_ms));
+}
+
+#ifdef CONFIG_APP_RADIO_ALIGN
+static bool put_radio(zcbor_state_t *zse)
+{
+	struct app_sensors_uplink_stats uplink;
+	struct app_state_write_stats state;
+	struct app_radio_stats radio;
+	uint64_t uptime_ms = MAX(k_uptime_get(), 1);
+
+	app_sensors_get_uplink_stats(&uplink);
+	app_state_get_write_stats(&state);
+	app_radio_get_stats(&radio);
+
+	/* Sensor uplinks and state writes are the traffic held for the radio */
+	const uint32_t radio_ms[] = {
+		radio.on_ms,
+		radio.connections,
+		radio.windows,
+		(uint32_t) (((uint64_t) radio.on_ms * MSEC_PER_SEC * 3600) / uptime_ms),
+		radio.on_ms / MAX(uplink.sent + state.sent, 1),
+		radio.psm_tau_s,
+		radio.psm_active_s,
+	};
+
+	return put_uint_list(zse, radio_ms, ARRAY_SIZE(radio_ms));
+}
+#endif
+
+#ifdef HAVE_TLS_HEAP_STATS
+static bool put_tls_heap(zcbor_state_t *zse)
+{
+	size_t cur_used, cur_blocks, max_used, max_blocks;
+
+	mbedtls_memory_buffer_alloc_cur_get(&cur_used, &cur_blocks);
+	mbedtls_memory_buffer_alloc_max_get(&max_used, &max_blocks);
+
+	const uint32_t tls[] = {cur_used, max_used, CONFIG_MBEDTLS_HEAP_SIZE};
+
+	return put_uint_list(zse, tls, ARRAY_SIZE(tls));
+}
+#endif
+
+struct metrics_entry {
+	const char *key;
+	bool (*put)(zcbor_state_t *zse);
+};
+
+/* One entry per key; the streamed map is sized from these tables */
+static const struct metrics_entry loop_entries[] = {
+	{"cycles", put_cycles},
+	{"loop", put_loop},
+	{"jitter", put_jitter},
+	{"overruns", put_overruns},
+};
+
+static const struct metrics_entry entries[] = {
+	{"up", put_uptime},
+	{"thr", put_threads},
+	{"ul", put_uplinks},
+	{"q", put_queue},
+	{"st", put_state_writes},
+	{"log", put_logs},
+	{"buf", put_bufs},
+	{"boot", put_boot},
+#ifdef CONFIG_APP_RADIO_ALIGN
+	{"radio", put_radio},
+#endif
+#ifdef HAVE_TLS_HEAP_STATS
+	{"tls", put_tls_heap},
+#endif
+};
+
+#define METRICS_KEYS (ARRAY_SIZE(loop_entries) + ARRAY_SIZE(entries))
+
+static int encode_entries(zcbor_state_t *zse, const struct metrics_entry *table, size_t count)
+{
+	bool ok = true;
+
+	for (size_t i = 0; ok && (i < count); i++) {
+		ok = zcbor_tstr_put_term(zse, table[i].key, SIZE_MAX) && table[i].put(zse);
+	}
+
+	return ok ? 0 : -ENOMEM;
+}
+
+int app_metrics_encode_loop(zcbor_state_t *zse)
+{
+	return encode_entries(zse, loop_entries, ARRAY_SIZE(loop_entries));
+}
+
+int app_metrics_encode(zcbor_state_t *zse)
+{
+	int err = encode_entries(zse, entries, ARRAY_SIZE(entries));
+
+	return err ? err : app_metrics_encode_loop(zse);
+}
+
+static void async_error_handler(struct golioth_client *client, enum golioth_status status,
+				const struct golioth_coap_rsp_code *coap_rsp_code, const char *path,
+				void *arg)
+{
+	if (status != GOLIOTH_OK) {
+		LOG_ERR("Async task failed: %d", status);
+	}
+}
+
+static void metrics_stream_work_handler(struct k_work *work)
+{
+	struct net_buf *buf;
+	int err;
+
+	k_work_schedule(&metrics_stream_work, K_SECONDS(CONFIG_APP_METRICS_STREAM_INTERVAL_S));
+
+	if (!golioth_client_is_connected(client)) {
+		return;
+	}
+
+	buf = app_uplink_buf_alloc(METRICS_STREAM_BUF_SIZE);
+	if (!buf) {
+		return;
+	}
+
+	ZCBOR_STATE_E(zse, 3, buf->data, net_buf_tailroom(buf), 1);
+
+	if (!zcbor_map_start_encode(zse, METRICS_KEYS) || app_metrics_encode(zse) ||
+	    !zcbor_map_end_encode(zse, METRICS_KEYS)) {
+		LOG_ERR("Failed to encode metrics");
+		goto out;
+	}
+
+	net_buf_add(buf, zse->payload - buf->data);
+
+	err = golioth_stream_set_async(client, "metrics", GOLIOTH_CONTENT_TYPE_CBOR, buf->data,
+				       buf->len, async_error_handler, NULL);
+	if (err) {
+		LOG_ERR("Failed to send metrics to Golioth: %d", err);
+	}
+
+out:
+	net_buf_unref(buf);
+}
+
+void app_metrics_init(struct golioth_client *metrics_client)
+{
+	client = metrics_client;
+
+	if (CONFIG_APP_METRICS_STREAM_INTERVAL_S > 0) {
+		k_work_schedule(&metrics_stream_work,
+				K_SECONDS(CONFIG_APP_METRICS_STREAM_INTERVAL_S));
+	}
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __APP_METRICS_H__
+#define __APP_METRICS_H__
+
+#include <errno.h>
+#include <golioth/client.h>
+#include <zcbor_encode.h>
+
+#ifdef CONFIG_APP_METRICS
+
+/**
+ * Add the runtime metrics to an open CBOR map
+ *
+ * Keys are kept short and values are arrays of integers; see "Runtime Metrics" in README.md
+ * for their layout.
+ *
+ * @retval 0 on success, -ENOMEM if the map ran out of room
+ */
+int app_metrics_encode(zcbor_state_t *zse);
+
+/**
+ * Add only the sensor loop scheduling metrics to an open CBOR map
+ *
+ * @retval 0 on success, -ENOMEM if the map ran out of room
+ */
+int app_metrics_encode_loop(zcbor_state_t *zse);
+
+/* Stream the metrics every CONFIG_APP_METRICS_STREAM_INTERVAL_S, if that is not zero */
+void app_metrics_init(struct golioth_client *client);
+
+#else
+
+static inline int app_metrics_encode(zcbor_state_t *zse)
+{
+	return -ENOTSUP;
+}
+
+static inline int app_metrics_encode_loop(zcbor_state_t *zse)
+{
+	return -ENOTSUP;
+}
+
+static inline void app_metrics_init(struct golioth_client *client)
+{
+}
+
+#endif /* CONFIG_APP_METRICS */
+
+#endif /* __APP_METRICS_H__ */
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(app_motion, LOG_LEVEL_DBG);
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+#include "app_motion.h"
+#include "app_settings.h"
+#include "main.h"
+
+/*
+ * The ADXL362 runs in linked mode (CONFIG_ADXL362_INTERRUPT_MODE=1): once an activity interrupt
+ * fires, the next interrupt is always inactivity and vice versa. Activity takes a reading straight
+ * away and caps every sensor period at MOTION_FAST_DELAY_S. Inactivity starts a hold-off of
+ * MOTION_HOLD_S; if no new activity arrives before it ends the normal periods apply again.
+ */
+
+static const struct device *accel = DEVICE_DT_GET_ONE(adi_adxl362);
+
+static atomic_t moving;
+static atomic_t still_since_ms; /* k_uptime_get_32() at the last inactivity, 0 while active */
+
+static void motion_trigger_handler(const struct device *dev, const struct sensor_trigger *trig)
+{
+	if (trig->type == SENSOR_TRIG_MOTION) {
+		atomic_set(&still_since_ms, 0);
+
+		if (atomic_set(&moving, 1) == 0) {
+			LOG_INF("Motion detected, sampling at least every %d s",
+				get_motion_fast_delay_s());
+			wake_system_thread();
+		}
+	} else if (trig->type == SENSOR_TRIG_STATIONARY) {
+		/* Zero means "active", so never store it as a timestamp */
+		atomic_set(&still_since_ms, MAX(k_uptime_get_32(), 1));
+		LOG_DBG("Inactivity detected");
+	}
+}
+
+int app_motion_apply_thresholds(void)
+{
+	/* Thresholds are in raw LSBs, which are 1 mg with CONFIG_ADXL362_ACCEL_RANGE_2G. The
+	 * driver applies them to all axes but requires a single-axis channel.
+	 */
+	struct sensor_value act = {.val1 = get_motion_act_thresh_mg()};
+	struct sensor_value inact = {.val1 = get_motion_inact_thresh_mg()};
+	int err;
+
+	err = sensor_attr_set(accel, SENSOR_CHAN_ACCEL_X, SENSOR_ATTR_UPPER_THRESH, &act);
+	if (err) {
+		LOG_ERR("Unable to set activity threshold: %d", err);
+		return err;
+	}
+
+	err = sensor_attr_set(accel, SENSOR_CHAN_ACCEL_X, SENSOR_ATTR_LOWER_THRESH, &inact);
+	if (err) {
+		LOG_ERR("Unable to set inactivity threshold: %d", err);
+	}
+
+	return err;
+}
+
+bool app_motion_is_moving(void)
+{
+	if (!atomic_get(&moving)) {
+		return false;
+	}
+
+	uint32_t still_since = atomic_get(&still_since_ms);
+	uint32_t hold_ms = get_motion_hold_s() * MSEC_PER_SEC;
+
+	if (still_since && ((k_uptime_get_32() - still_since) >= hold_ms)) {
+		atomic_set(&moving, 0);
+		LOG_INF("No motion for %d s, back to the normal sensor periods",
+			get_motion_hold_s());
+		return false;
+	}
+
+	return true;
+}
+
+int app_motion_init(void)
+{
+	static const struct sensor_trigger motion_trig = {
+		.type = SENSOR_TRIG_MOTION,
+		.chan = SENSOR_CHAN_ACCEL_XYZ,
+	};
+	static const struct sensor_trigger stationary_trig = {
+		.type = SENSOR_TRIG_STATIONARY,
+		.chan = SENSOR_CHAN_ACCEL_XYZ,
+	};
+	int err;
+
+	if (!device_is_ready(accel)) {
+		LOG_ERR("Accelerometer not ready");
+		return -ENODEV;
+	}
+
+	err = app_motion_apply_thresholds();
+	if (err) {
+		return err;
+	}
+
+	err = sensor_trigger_set(accel, &motion_trig, motion_trigger_handler);
+	if (err) {
+		LOG_ERR("Unable to set motion trigger: %d", err);
+		return err;
+	}
+
+	err = sensor_trigger_set(accel, &stationary_trig, motion_trigger_handler);
+	if (err) {
+		LOG_ERR("Unable to set stationary trigger: %d", err);
+	}
+
+	return err;
+}
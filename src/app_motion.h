@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __APP_MOTION_H__
+#define __APP_MOTION_H__
+
+#include <stdbool.h>
+
+#ifdef CONFIG_APP_MOTION_TRIGGER
+
+int app_motion_init(void);
+int app_motion_apply_thresholds(void);
+
+/* True from an activity interrupt until MOTION_HOLD_S after the following inactivity */
+bool app_motion_is_moving(void);
+
+#else
+
+static inline int app_motion_init(void)
+{
+	return 0;
+}
+
+static inline int app_motion_apply_thresholds(void)
+{
+	return 0;
+}
+
+static inline bool app_motion_is_moving(void)
+{
+	return false;
+}
+
+#endif /* CONFIG_APP_MOTION_TRIGGER */
+
+#endif /* __APP_MOTION_H__ */
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(app_persist, LOG_LEVEL_DBG);
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/atomic.h>
+
+#include "app_persist.h"
+#include "app_settings.h"
+#include "app_state.h"
+
+/*
+ * Last-applied settings and the LightDB State counters are kept under the "app" settings
+ * subtree, next to the Golioth credentials. CONFIG_GOLIOTH_SAMPLE_SETTINGS_AUTOLOAD runs
+ * settings_load() during system init, so the device starts sampling with them instead of the
+ * compile-time defaults. Values that arrive later from the cloud are applied as usual and
+ * saved again if they differ.
+ */
+
+#define PERSIST_SUBTREE	 "app"
+#define SETTINGS_KEY	 "cfg"
+#define COUNTERS_KEY	 "ctr"
+
+/* Bump when struct app_config changes meaning without changing size */
+#define SETTINGS_FORMAT 1
+
+struct persisted_settings {
+	uint32_t format;
+	struct app_config cfg;
+};
+
+struct persisted_counters {
+	uint16_t up;
+	uint16_t dn;
+};
+
+static void persist_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(persist_work, persist_work_handler);
+
+static atomic_t dirty;
+
+/* What flash holds now, so unchanged values are never written again */
+static struct persisted_settings saved_settings;
+static struct persisted_counters saved_counters;
+
+static int persist_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+	const char *next;
+	int rc;
+
+	if (settings_name_steq(name, SETTINGS_KEY, &next) && !next) {
+		struct persisted_settings loaded;
+
+		if (len != sizeof(loaded)) {
+			LOG_WRN("Ignoring saved settings of %zu bytes (expected %zu)", len,
+				sizeof(loaded));
+			return 0;
+		}
+
+		rc = read_cb(cb_arg, &loaded, sizeof(loaded));
+		if (rc < 0) {
+			return rc;
+		}
+
+		if (loaded.format != SETTINGS_FORMAT) {
+			LOG_WRN("Ignoring saved settings in format %u", loaded.format);
+			return 0;
+		}
+
+		app_settings_restore(&loaded.cfg);
+		saved_settings = loaded;
+		LOG_INF("Restored settings saved before reboot");
+
+		return 0;
+	}
+
+	if (settings_name_steq(name, COUNTERS_KEY, &next) && !next) {
+		struct persisted_counters loaded;
+
+		if (len != sizeof(loaded)) {
+			return 0;
+		}
+
+		rc = read_cb(cb_arg, &loaded, sizeof(loaded));
+		if (rc < 0) {
+			return rc;
+		}
+
+		app_state_restore_counters(loaded.up, loaded.dn);
+		saved_counters = loaded;
+		LOG_INF("Restored counters: up %u, down %u", loaded.up, loaded.dn);
+
+		return 0;
+	}
+
+	return -ENOENT;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(app_persist, PERSIST_SUBTREE, NULL, persist_set, NULL, NULL);
+
+static void save_settings(void)
+{
+	struct persisted_settings current = {.format = SETTINGS_FORMAT};
+
+	app_settings_snapshot(&current.cfg);
+
+	if (memcmp(&current, &saved_settings, sizeof(current)) == 0) {
+		return;
+	}
+
+	int err = settings_save_one(PERSIST_SUBTREE "/" SETTINGS_KEY, &current, sizeof(current));
+
+	if (err) {
+		LOG_ERR("Failed to save settings: %d", err);
+		return;
+	}
+
+	saved_settings = current;
+	LOG_DBG("Saved settings (%zu bytes)", sizeof(current));
+}
+
+static void save_counters(void)
+{
+	struct persisted_counters current;
+
+	app_state_get_counters(&current.up, &current.dn);
+
+	if (memcmp(&current, &saved_counters, sizeof(current)) == 0) {
+		return;
+	}
+
+	int err = settings_save_one(PERSIST_SUBTREE "/" COUNTERS_KEY, &current, sizeof(current));
+
+	if (err) {
+		LOG_ERR("Failed to save counters: %d", err);
+		return;
+	}
+
+	saved_counters = current;
+	LOG_DBG("Saved counters");
+}
+
+static void persist_work_handler(struct k_work *work)
+{
+	atomic_val_t items = atomic_clear(&dirty);
+
+	if (items & BIT(APP_PERSIST_SETTINGS)) {
+		save_settings();
+	}
+
+	if (items & BIT(APP_PERSIST_COUNTERS)) {
+		save_counters();
+	}
+}
+
+void app_persist_mark_dirty(enum app_persist_item item)
+{
+	atomic_set_bit(&dirty, item);
+
+	if (item == APP_PERSIST_SETTINGS) {
+		uint32_t delay_ms = CONFIG_APP_PERSIST_SETTINGS_DELAY_S * MSEC_PER_SEC;
+		k_ticks_t remaining = k_work_delayable_remaining_get(&persist_work);
+
+		/* Bring forward a counter save that is further away; it takes settings along */
+		if (!k_work_delayable_is_pending(&persist_work) ||
+		    (remaining > k_ms_to_ticks_ceil32(delay_ms))) {
+			k_work_reschedule(&persist_work, K_MSEC(delay_ms));
+		}
+	} else {
+		/* Leaves a pending save alone, so counters hit flash at most once an interval */
+		k_work_schedule(&persist_work, K_SECONDS(CONFIG_APP_PERSIST_COUNTERS_INTERVAL_S));
+	}
+}
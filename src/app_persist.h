@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __APP_PERSIST_H__
+#define __APP_PERSIST_H__
+
+enum app_persist_item {
+	APP_PERSIST_SETTINGS,
+	APP_PERSIST_COUNTERS,
+};
+
+#ifdef CONFIG_APP_PERSIST
+
+/**
+ * Note that @p item changed and should be written to flash
+ *
+ * Settings are written CONFIG_APP_PERSIST_SETTINGS_DELAY_S after they change and counters at
+ * most once every CONFIG_APP_PERSIST_COUNTERS_INTERVAL_S. Both are restored by settings_load()
+ * before main() runs.
+ */
+void app_persist_mark_dirty(enum app_persist_item item);
+
+#else
+
+static inline void app_persist_mark_dirty(enum app_persist_item item)
+{
+}
+
+#endif /* CONFIG_APP_PERSIST */
+
+#endif /* __APP_PERSIST_H__ */
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(app_radio, LOG_LEVEL_DBG);
+
+#include <modem/lte_lc.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+#include "app_radio.h"
+#include "main.h"
+
+/*
+ * An uplink that has to bring the radio out of idle pays for the RRC connection setup and the
+ * network's inactivity timer on its own; one that rides along with a connection that is already
+ * up costs little more than its airtime. Sensor samples and LightDB State writes are therefore
+ * held while the modem is RRC idle and released together in a window, opened when the modem
+ * connects for anything else (a downlink, a TAU, another uplink) or when the oldest held traffic
+ * has waited CONFIG_APP_RADIO_HOLD_S. The main loop sends what is held when a window opens.
+ */
+
+#define HOLD_MS ((int64_t) CONFIG_APP_RADIO_HOLD_S * MSEC_PER_SEC)
+
+static struct k_spinlock lock;
+static bool rrc_connected;
+static int64_t connected_since_ms;
+static int64_t on_ms; /* completed connections only */
+static struct app_radio_stats stats;
+static atomic_t window_pending;
+
+static void open_window(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	stats.windows++;
+	k_spin_unlock(&lock, key);
+
+	atomic_set(&window_pending, 1);
+	wake_system_thread();
+}
+
+static void deadline_work_handler(struct k_work *work)
+{
+	LOG_DBG("Held uplinks reached %d s, sending them now", CONFIG_APP_RADIO_HOLD_S);
+	open_window();
+}
+
+static K_WORK_DELAYABLE_DEFINE(deadline_work, deadline_work_handler);
+
+static void on_rrc_update(enum lte_lc_rrc_mode mode)
+{
+	bool connected = (mode == LTE_LC_RRC_MODE_CONNECTED);
+	int64_t now_ms = k_uptime_get();
+	int64_t session_ms = 0;
+	bool changed;
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	changed = (connected != rrc_connected);
+	rrc_connected = connected;
+
+	if (changed && connected) {
+		connected_since_ms = now_ms;
+		stats.connections++;
+	} else if (changed) {
+		session_ms = now_ms - connected_since_ms;
+		on_ms += session_ms;
+	}
+
+	k_spin_unlock(&lock, key);
+
+	if (!changed) {
+		return;
+	}
+
+	if (connected) {
+		/* Everything held can share this connection */
+		k_work_cancel_delayable(&deadline_work);
+		open_window();
+	} else {
+		LOG_DBG("Radio idle after %d ms connected", (int) session_ms);
+	}
+}
+
+static void lte_event_handler(const struct lte_lc_evt *const evt)
+{
+	k_spinlock_key_t key;
+
+	switch (evt->type) {
+	case LTE_LC_EVT_RRC_UPDATE:
+		on_rrc_update(evt->rrc_mode);
+		break;
+	case LTE_LC_EVT_PSM_UPDATE:
+		/* A negative active time means the network did not grant PSM */
+		key = k_spin_lock(&lock);
+		stats.psm_tau_s = (evt->psm_cfg.active_time >= 0) ? MAX(evt->psm_cfg.tau, 0) : 0;
+		stats.psm_active_s = MAX(evt->psm_cfg.active_time, 0);
+		k_spin_unlock(&lock, key);
+
+		LOG_INF("PSM TAU %d s, active time %d s", evt->psm_cfg.tau,
+			evt->psm_cfg.active_time);
+		break;
+	case LTE_LC_EVT_EDRX_UPDATE:
+		LOG_INF("eDRX cycle %d ms, paging time window %d ms",
+			(int) (evt->edrx_cfg.edrx * MSEC_PER_SEC),
+			(int) (evt->edrx_cfg.ptw * MSEC_PER_SEC));
+		break;
+	default:
+		break;
+	}
+}
+
+int app_radio_init(void)
+{
+	int ret = 0;
+	int err;
+
+	lte_lc_register_handler(lte_event_handler);
+
+	err = lte_lc_psm_param_set_seconds(CONFIG_APP_RADIO_PSM_TAU_S,
+					   CONFIG_APP_RADIO_PSM_ACTIVE_S);
+	if (!err) {
+		err = lte_lc_psm_req(true);
+	}
+	if (err) {
+		LOG_ERR("Unable to request PSM: %d", err);
+		ret = err;
+	}
+
+	err = lte_lc_edrx_param_set(LTE_LC_LTE_MODE_LTEM, CONFIG_APP_RADIO_EDRX_VALUE);
+	if (!err) {
+		err = lte_lc_edrx_req(true);
+	}
+	if (err) {
+		LOG_ERR("Unable to request eDRX: %d", err);
+		ret = ret ? ret : err;
+	}
+
+	return ret;
+}
+
+int64_t app_radio_hold_ms(int64_t since_ms)
+{
+	int64_t left_ms = since_ms + HOLD_MS - k_uptime_get();
+	bool connected;
+
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	connected = rrc_connected;
+	k_spin_unlock(&lock, key);
+
+	if (connected || (left_ms <= 0)) {
+		return 0;
+	}
+
+	/* The oldest held traffic sets the deadline; anything held later goes out with it */
+	k_work_schedule(&deadline_work, K_MSEC(left_ms));
+
+	return left_ms;
+}
+
+bool app_radio_take_window(void)
+{
+	return atomic_set(&window_pending, 0) != 0;
+}
+
+void app_radio_get_stats(struct app_radio_stats *out)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	int64_t total_ms = on_ms;
+
+	if (rrc_connected) {
+		total_ms += k_uptime_get() - connected_since_ms;
+	}
+
+	*out = stats;
+	out->on_ms = (uint32_t) total_ms;
+	k_spin_unlock(&lock, key);
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __APP_RADIO_H__
+#define __APP_RADIO_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct app_radio_stats {
+	uint32_t on_ms;        /* time spent RRC connected since boot */
+	uint32_t connections;  /* RRC connections since boot */
+	uint32_t windows;      /* times held uplinks were released */
+	uint32_t psm_tau_s;    /* periodic TAU granted by the network, 0 without PSM */
+	uint32_t psm_active_s; /* active time granted by the network */
+};
+
+#ifdef CONFIG_APP_RADIO_ALIGN
+
+/* Request the PSM and eDRX timers and follow the modem's RRC state; call before connecting */
+int app_radio_init(void);
+
+/**
+ * How much longer uplink traffic first held at @p since_ms may wait for the radio
+ *
+ * Traffic is held while the modem is RRC idle, for at most CONFIG_APP_RADIO_HOLD_S. A window is
+ * opened when the modem connects for any reason or when the oldest held traffic reaches that
+ * limit, whichever comes first.
+ *
+ * @retval 0 Send now
+ * @retval >0 Milliseconds until the held traffic must go out anyway
+ */
+int64_t app_radio_hold_ms(int64_t since_ms);
+
+/* True once for every window opened since the last call; held traffic should be sent now */
+bool app_radio_take_window(void);
+
+void app_radio_get_stats(struct app_radio_stats *stats);
+
+#else
+
+static inline int app_radio_init(void)
+{
+	return 0;
+}
+
+static inline int64_t app_radio_hold_ms(int64_t since_ms)
+{
+	return 0;
+}
+
+static inline bool app_radio_take_window(void)
+{
+	return false;
+}
+
+static inline void app_radio_get_stats(struct app_radio_stats *stats)
+{
+	*stats = (struct app_radio_stats) {0};
+}
+
+#endif /* CONFIG_APP_RADIO_ALIGN */
+
+#endif /* __APP_RADIO_H__ */
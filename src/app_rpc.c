@@ -7,6 +7,7 @@
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(app_rpc, LOG_LEVEL_DBG);
 
+#include <string.h>
 #include <golioth/client.h>
 #include <golioth/rpc.h>
 #include <zephyr/logging/log_ctrl.h>
@@ -17,8 +18,12 @@ LOG_MODULE_REGISTER(app_rpc, LOG_LEVEL_DBG);
 #endif
 
 #include "app_buzzer.h"
+#include "app_metrics.h"
 #include "app_rpc.h"
 
+/* Longest module name pattern accepted by set_log_level */
+#define LOG_PATTERN_MAX_LEN 32
+
 static void reboot_work_handler(struct k_work *work)
 {
 	for (int8_t i = 5; i >= 0; i--) {
@@ -44,10 +49,40 @@ static enum golioth_rpc_status on_get_network_info(zcbor_state_t *request_params
 		    (return GOLIOTH_RPC_UNIMPLEMENTED););
 }
 
+/* Match a module name against a pattern in which '*' stands for any run of characters */
+static bool log_source_matches(const char *pattern, const char *name)
+{
+	const char *star = NULL;
+	const char *resume = NULL;
+
+	while (*name) {
+		if (*pattern == '*') {
+			star = pattern++;
+			resume = name;
+		} else if (*pattern == *name) {
+			pattern++;
+			name++;
+		} else if (star) {
+			pattern = star + 1;
+			name = ++resume;
+		} else {
+			return false;
+		}
+	}
+
+	while (*pattern == '*') {
+		pattern++;
+	}
+
+	return *pattern == '\0';
+}
+
 static enum golioth_rpc_status on_set_log_level(zcbor_state_t *request_params_array,
 						zcbor_state_t *response_detail_map,
 						void *callback_arg)
 {
+	char pattern[LOG_PATTERN_MAX_LEN + 1] = "*";
+	struct zcbor_string module;
 	double param_0;
 	uint8_t log_level;
 	bool ok;
@@ -68,7 +103,20 @@ static enum golioth_rpc_status on_set_log_level(zcbor_state_t *request_params_ar
 		return GOLIOTH_RPC_INVALID_ARGUMENT;
 	}
 
+	/* Optional second parameter selects modules by name, e.g. "app_sensors" or "golioth_*" */
+	if (!zcbor_array_at_end(request_params_array)) {
+		if (!zcbor_tstr_decode(request_params_array, &module) ||
+		    (module.len == 0) || (module.len >= sizeof(pattern))) {
+			LOG_ERR("Failed to decode module name");
+			return GOLIOTH_RPC_INVALID_ARGUMENT;
+		}
+
+		memcpy(pattern, module.value, module.len);
+		pattern[module.len] = '\0';
+	}
+
 	int source_id = 0;
+	int matched = 0;
 	char *source_name;
 
 	while (1) {
@@ -77,14 +125,23 @@ static enum golioth_rpc_status on_set_log_level(zcbor_state_t *request_params_ar
 			break;
 		}
 
-		log_filter_set(NULL, 0, source_id, log_level);
+		if (log_source_matches(pattern, source_name)) {
+			log_filter_set(NULL, 0, source_id, log_level);
+			++matched;
+		}
 		++source_id;
 	}
 
-	LOG_WRN("Log levels for %d modules set to: %d", source_id, log_level);
+	if (matched == 0) {
+		LOG_ERR("No log module matches \"%s\"", pattern);
+		return GOLIOTH_RPC_NOT_FOUND;
+	}
+
+	LOG_WRN("Log levels for %d modules matching \"%s\" set to: %d", matched, pattern,
+		log_level);
 
 	ok = zcbor_tstr_put_lit(response_detail_map, "log_modules") &&
-	     zcbor_float64_put(response_detail_map, (double)source_id);
+	     zcbor_float64_put(response_detail_map, (double)matched);
 
 	return GOLIOTH_RPC_OK;
 }
@@ -140,6 +197,72 @@ static enum golioth_rpc_status on_play_song(zcbor_state_t *request_params_array,
 #endif /* CONFIG_BOARD_THINGY91_NRF9160_NS */
 }
 
+static enum golioth_rpc_status on_play_rtttl(zcbor_state_t *request_params_array,
+					     zcbor_state_t *response_detail_map,
+					     void *callback_arg)
+{
+#if defined(CONFIG_BOARD_THINGY91_NRF9160_NS)
+
+	struct zcbor_string rtttl;
+	bool ok;
+
+	ok = zcbor_tstr_decode(request_params_array, &rtttl);
+	if (!ok) {
+		LOG_ERR("Failed to decode RPC string argument");
+		return GOLIOTH_RPC_INVALID_ARGUMENT;
+	}
+
+	int ret = app_buzzer_play_rtttl(rtttl.value, rtttl.len);
+
+	if (ret == -ENOBUFS) {
+		return GOLIOTH_RPC_RESOURCE_EXHAUSTED;
+	}
+
+	if (ret < 0) {
+		LOG_ERR("Unable to play RTTTL tune: %d", ret);
+		ok = zcbor_tstr_put_lit(response_detail_map, "error") &&
+		     zcbor_tstr_put_lit(response_detail_map,
+					(ret == -E2BIG) ? "too many notes" : "invalid RTTTL");
+		return GOLIOTH_RPC_INVALID_ARGUMENT;
+	}
+
+	ok = zcbor_tstr_put_lit(response_detail_map, "notes") &&
+	     zcbor_uint32_put(response_detail_map, ret);
+	return ok ? GOLIOTH_RPC_OK : GOLIOTH_RPC_RESOURCE_EXHAUSTED;
+
+#else
+
+	return GOLIOTH_RPC_UNIMPLEMENTED;
+
+#endif /* CONFIG_BOARD_THINGY91_NRF9160_NS */
+}
+
+static enum golioth_rpc_status on_get_loop_stats(zcbor_state_t *request_params_array,
+						 zcbor_state_t *response_detail_map,
+						 void *callback_arg)
+{
+	int err = app_metrics_encode_loop(response_detail_map);
+
+	if (err == -ENOTSUP) {
+		return GOLIOTH_RPC_UNIMPLEMENTED;
+	}
+
+	return err ? GOLIOTH_RPC_RESOURCE_EXHAUSTED : GOLIOTH_RPC_OK;
+}
+
+static enum golioth_rpc_status on_get_metrics(zcbor_state_t *request_params_array,
+					      zcbor_state_t *response_detail_map,
+					      void *callback_arg)
+{
+	int err = app_metrics_encode(response_detail_map);
+
+	if (err == -ENOTSUP) {
+		return GOLIOTH_RPC_UNIMPLEMENTED;
+	}
+
+	return err ? GOLIOTH_RPC_RESOURCE_EXHAUSTED : GOLIOTH_RPC_OK;
+}
+
 static enum golioth_rpc_status on_reboot(zcbor_state_t *request_params_array,
 					 zcbor_state_t *response_detail_map, void *callback_arg)
 {
@@ -173,4 +296,13 @@ void app_rpc_register(struct golioth_client *client)
 
 	err = golioth_rpc_register(rpc, "play_song", on_play_song, NULL);
 	rpc_log_if_register_failure(err);
+
+	err = golioth_rpc_register(rpc, "play_rtttl", on_play_rtttl, NULL);
+	rpc_log_if_register_failure(err);
+
+	err = golioth_rpc_register(rpc, "get_loop_stats", on_get_loop_stats, NULL);
+	rpc_log_if_register_failure(err);
+
+	err = golioth_rpc_register(rpc, "get_metrics", on_get_metrics, NULL);
+	rpc_log_if_register_failure(err);
 }
@@ -0,0 +1,712 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(app_sample_queue, LOG_LEVEL_DBG);
+
+#include <errno.h>
+#include <string.h>
+#include <golioth/client.h>
+#include <golioth/stream.h>
+#include <zephyr/fs/fcb.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net_buf.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/atomic.h>
+
+#include "app_batch.h"
+#include "app_sample_queue.h"
+#include "app_uplink_buf.h"
+
+/*
+ * Samples are appended to a Flash Circular Buffer (FCB) in the dedicated
+ * "sample_storage" partition. Every sample is written exactly once; a sector
+ * is only erased when the oldest sector has been fully uploaded or when the
+ * queue is full and the oldest data must make room. Erases are counted against
+ * a rolling budget so flash wear stays bounded even during long outages. The
+ * budget is saved with the settings on every erase, and the position of the
+ * last uploaded sample whenever it moves, so rebooting neither resets the
+ * budget nor uploads samples again.
+ *
+ * Queued samples are uploaded from the system work queue one batch at a time;
+ * the next batch is only read from flash once Golioth has acknowledged the
+ * previous one.
+ */
+
+#define SAMPLE_QUEUE_PARTITION_ID FIXED_PARTITION_ID(sample_storage)
+#define SAMPLE_QUEUE_MAGIC	  0x53514631 /* "SQF1" */
+#define SAMPLE_QUEUE_VERSION	  1
+
+#define ERASE_BUDGET_WINDOW_MS (24 * 60 * 60 * MSEC_PER_SEC)
+
+#define PERSIST_SUBTREE "sq"
+#define BUDGET_KEY	"budget"
+#define CURSOR_KEY	"cursor"
+
+#define SAMPLE_FLAG_TS_UNIX BIT(0)
+#define SAMPLE_FLAG_COMPACT BIT(1)
+#define SAMPLE_FLAG_SUMMARY BIT(2) /* window summary, replayed on its own to the summary path */
+
+/* Header stored in flash ahead of each CBOR encoded sample */
+struct sample_hdr {
+	int64_t ts_ms;
+	uint8_t flags;
+} __packed;
+
+static struct flash_sector sectors[CONFIG_APP_SAMPLE_QUEUE_MAX_SECTORS];
+static struct fcb fcb;
+static bool initialized;
+
+/* Location of the last uploaded entry; fe_sector == NULL means "before the oldest entry" */
+static struct fcb_entry cursor;
+
+/* Entries at the head of the queue that were written before this boot; their uptime based
+ * timestamps can no longer be converted to wall clock time.
+ */
+static uint32_t prev_boot_entries;
+
+static int64_t erase_window_start;
+static struct app_sample_queue_stats stats = {
+	.erase_budget = CONFIG_APP_SAMPLE_QUEUE_ERASE_BUDGET,
+};
+
+/* Erase budget window as saved in the settings */
+struct persisted_budget {
+	uint32_t erases;     /* erases counted in the window */
+	uint32_t elapsed_ms; /* uptime the window had run for; time powered off is not counted */
+};
+
+/* Cursor as saved in the settings */
+struct persisted_cursor {
+	uint32_t sector;   /* index into sectors[], or UINT32_MAX before the oldest entry */
+	uint32_t elem_off; /* fe_elem_off of the last uploaded entry */
+};
+
+/* Loaded before the FCB is up; resolved to an entry by app_sample_queue_init() */
+static struct persisted_cursor saved_cursor = {.sector = UINT32_MAX};
+
+/* Batch handed to the Golioth client and not acknowledged yet; buf is NULL when idle */
+static struct {
+	struct net_buf *buf;
+	struct fcb_entry last;
+	uint32_t prev_boot;
+	uint16_t count;
+	bool stale; /* its first samples were erased to make room; keep the cursor */
+	atomic_t done;
+	enum golioth_status status;
+} upload;
+
+static struct golioth_client *drain_client;
+static int drain_batches_left;
+static uint32_t drain_uploaded;
+
+K_MUTEX_DEFINE(queue_mutex);
+
+#ifdef CONFIG_SETTINGS
+/* Runs from settings_load() before app_sample_queue_init() */
+static int queue_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+	const char *next;
+	int rc;
+
+	if (settings_name_steq(name, BUDGET_KEY, &next) && !next) {
+		struct persisted_budget loaded;
+
+		if (len != sizeof(loaded)) {
+			return 0;
+		}
+
+		rc = read_cb(cb_arg, &loaded, sizeof(loaded));
+		if (rc < 0) {
+			return rc;
+		}
+
+		stats.erases_in_window = loaded.erases;
+		erase_window_start =
+			k_uptime_get() - MIN(loaded.elapsed_ms, ERASE_BUDGET_WINDOW_MS);
+
+		return 0;
+	}
+
+	if (settings_name_steq(name, CURSOR_KEY, &next) && !next) {
+		if (len != sizeof(saved_cursor)) {
+			return 0;
+		}
+
+		rc = read_cb(cb_arg, &saved_cursor, sizeof(saved_cursor));
+
+		return (rc < 0) ? rc : 0;
+	}
+
+	return -ENOENT;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(app_sample_queue, PERSIST_SUBTREE, NULL, queue_set, NULL, NULL);
+
+static void save_budget(void)
+{
+	struct persisted_budget current = {
+		.erases = stats.erases_in_window,
+		.elapsed_ms = k_uptime_get() - erase_window_start,
+	};
+	int err = settings_save_one(PERSIST_SUBTREE "/" BUDGET_KEY, &current, sizeof(current));
+
+	if (err) {
+		LOG_WRN("Failed to save erase budget: %d", err);
+	}
+}
+
+/* Call whenever the cursor moves; a sector is only reused after it has been rotated, which
+ * resets a cursor pointing into it, so the saved position never names a newer sample.
+ */
+static void save_cursor(void)
+{
+	struct persisted_cursor current = {.sector = UINT32_MAX};
+	int err;
+
+	if (cursor.fe_sector != NULL) {
+		current.sector = cursor.fe_sector - sectors;
+		current.elem_off = cursor.fe_elem_off;
+	}
+
+	if (memcmp(&current, &saved_cursor, sizeof(current)) == 0) {
+		return;
+	}
+
+	err = settings_save_one(PERSIST_SUBTREE "/" CURSOR_KEY, &current, sizeof(current));
+	if (err) {
+		LOG_WRN("Failed to save sample queue position: %d", err);
+		return;
+	}
+
+	saved_cursor = current;
+}
+#else
+static void save_budget(void)
+{
+}
+
+static void save_cursor(void)
+{
+}
+#endif /* CONFIG_SETTINGS */
+
+static bool erase_allowed(void)
+{
+	int64_t now = k_uptime_get();
+
+	if ((now - erase_window_start) >= ERASE_BUDGET_WINDOW_MS) {
+		erase_window_start = now;
+		stats.erases_in_window = 0;
+	}
+
+	return stats.erases_in_window < stats.erase_budget;
+}
+
+static uint32_t count_unsent_in_oldest(void)
+{
+	struct fcb_entry loc = cursor;
+	uint32_t count = 0;
+
+	if ((loc.fe_sector != NULL) && (loc.fe_sector != fcb.f_oldest)) {
+		/* Oldest sector has been fully uploaded */
+		return 0;
+	}
+
+	while ((fcb_getnext(&fcb, &loc) == 0) && (loc.fe_sector == fcb.f_oldest)) {
+		count++;
+	}
+
+	return count;
+}
+
+/* Erase the oldest sector, discarding any samples in it that were not uploaded yet */
+static int rotate_oldest(void)
+{
+	if (!erase_allowed()) {
+		return -EBUSY;
+	}
+
+	uint32_t lost = count_unsent_in_oldest();
+	bool cursor_in_oldest = (cursor.fe_sector == fcb.f_oldest);
+
+	int err = fcb_rotate(&fcb);
+
+	if (err) {
+		LOG_ERR("Failed to rotate sample queue: %d", err);
+		return err;
+	}
+
+	stats.erases++;
+	stats.erases_in_window++;
+	save_budget();
+
+	if (cursor_in_oldest) {
+		memset(&cursor, 0, sizeof(cursor));
+		save_cursor();
+	}
+
+	if (lost && upload.buf) {
+		upload.stale = true;
+	}
+
+	if (lost) {
+		LOG_WRN("Sample queue full, discarded %u oldest samples", lost);
+		stats.dropped += lost;
+		stats.pending -= MIN(lost, stats.pending);
+		prev_boot_entries -= MIN(lost, prev_boot_entries);
+	}
+
+	return 0;
+}
+
+/* Reclaim sectors whose samples have all been uploaded */
+static void release_uploaded_sectors(void)
+{
+	while ((cursor.fe_sector != NULL) && (cursor.fe_sector != fcb.f_oldest)) {
+		if (rotate_oldest() != 0) {
+			/* Out of erase budget; the sector is reclaimed on a later drain */
+			break;
+		}
+	}
+}
+
+static int erase_partition(void)
+{
+	const struct flash_area *fa;
+	int err = flash_area_open(SAMPLE_QUEUE_PARTITION_ID, &fa);
+
+	if (err) {
+		return err;
+	}
+
+	err = flash_area_erase(fa, 0, fa->fa_size);
+	flash_area_close(fa);
+
+	return err;
+}
+
+int app_sample_queue_init(void)
+{
+	uint32_t sector_cnt = ARRAY_SIZE(sectors);
+	struct fcb_entry loc = {0};
+	int err;
+
+	err = flash_area_get_sectors(SAMPLE_QUEUE_PARTITION_ID, &sector_cnt, sectors);
+	if (err) {
+		LOG_ERR("Unable to read sample queue partition layout: %d", err);
+		return err;
+	}
+
+	fcb.f_magic = SAMPLE_QUEUE_MAGIC;
+	fcb.f_version = SAMPLE_QUEUE_VERSION;
+	fcb.f_sector_cnt = sector_cnt;
+	fcb.f_scratch_cnt = 0;
+	fcb.f_sectors = sectors;
+
+	err = fcb_init(SAMPLE_QUEUE_PARTITION_ID, &fcb);
+	if (err) {
+		LOG_WRN("Sample queue partition not formatted (%d), erasing", err);
+
+		err = erase_partition();
+		if (err) {
+			LOG_ERR("Unable to erase sample queue partition: %d", err);
+			return err;
+		}
+
+		stats.erases += sector_cnt;
+
+		err = fcb_init(SAMPLE_QUEUE_PARTITION_ID, &fcb);
+		if (err) {
+			LOG_ERR("Unable to initialize sample queue: %d", err);
+			return err;
+		}
+
+		/* Whatever position was saved pointed into the old contents */
+		saved_cursor.sector = UINT32_MAX;
+	}
+
+	while (fcb_getnext(&fcb, &loc) == 0) {
+		stats.pending++;
+
+		/* Everything up to the last uploaded entry has already reached Golioth */
+		if ((saved_cursor.sector < sector_cnt) &&
+		    (loc.fe_sector == &sectors[saved_cursor.sector]) &&
+		    (loc.fe_elem_off == saved_cursor.elem_off)) {
+			cursor = loc;
+			stats.pending = 0;
+		}
+	}
+
+	if ((saved_cursor.sector != UINT32_MAX) && (cursor.fe_sector == NULL)) {
+		LOG_WRN("Saved upload position not found, uploading the whole queue");
+	}
+
+	save_cursor();
+
+	prev_boot_entries = stats.pending;
+	initialized = true;
+
+	LOG_INF("Sample queue ready: %u samples pending, %u sectors, erase budget %u/%u today",
+		stats.pending, sector_cnt, stats.erases_in_window, stats.erase_budget);
+
+	return 0;
+}
+
+static int push_entry(int64_t uptime_ms, uint8_t flags, const uint8_t *sample, size_t len)
+{
+	struct sample_hdr hdr = {
+		.ts_ms = uptime_ms,
+		.flags = flags,
+	};
+	struct fcb_entry loc;
+	int err;
+
+	if (!initialized) {
+		return -ENODEV;
+	}
+
+	if ((APP_BATCH_ARRAY_HDR_LEN + APP_BATCH_ENTRY_HDR_MAX_LEN + len) >
+	    CONFIG_APP_SAMPLE_QUEUE_BATCH_SIZE) {
+		LOG_ERR("Sample of %zu bytes can never fit in an upload batch", len);
+		return -EMSGSIZE;
+	}
+
+	int64_t unix_ms = app_batch_uptime_to_unix_ms(uptime_ms);
+
+	if (unix_ms >= 0) {
+		hdr.ts_ms = unix_ms;
+		hdr.flags |= SAMPLE_FLAG_TS_UNIX;
+	}
+
+	k_mutex_lock(&queue_mutex, K_FOREVER);
+
+	err = fcb_append(&fcb, sizeof(hdr) + len, &loc);
+	if (err == -ENOSPC) {
+		err = rotate_oldest();
+		if (err == 0) {
+			err = fcb_append(&fcb, sizeof(hdr) + len, &loc);
+		}
+	}
+
+	if (err) {
+		LOG_WRN("Unable to queue sample (erase budget %u/%u): %d", stats.erases_in_window,
+			stats.erase_budget, err);
+		stats.dropped++;
+		goto unlock;
+	}
+
+	err = flash_area_write(fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), &hdr, sizeof(hdr));
+	if (!err) {
+		err = flash_area_write(fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc) + sizeof(hdr), sample,
+				       len);
+	}
+	if (!err) {
+		err = fcb_append_finish(&fcb, &loc);
+	}
+
+	if (err) {
+		LOG_ERR("Failed to write sample to flash: %d", err);
+		stats.dropped++;
+		goto unlock;
+	}
+
+	stats.appended++;
+	stats.pending++;
+
+	LOG_DBG("Queued %zu byte sample; %u pending", len, stats.pending);
+
+unlock:
+	k_mutex_unlock(&queue_mutex);
+
+	return err;
+}
+
+int app_sample_queue_push(int64_t uptime_ms, enum app_batch_format format, const uint8_t *sample,
+			  size_t len)
+{
+	return push_entry(uptime_ms, (format == APP_BATCH_FORMAT_COMPACT) ? SAMPLE_FLAG_COMPACT : 0,
+			  sample, len);
+}
+
+/// Queue a window summary; it is uploaded as is to app_batch_summary_path(format)
+int app_sample_queue_push_summary(int64_t uptime_ms, enum app_batch_format format,
+				  const uint8_t *summary, size_t len)
+{
+	uint8_t flags = SAMPLE_FLAG_SUMMARY;
+
+	if (format == APP_BATCH_FORMAT_COMPACT) {
+		flags |= SAMPLE_FLAG_COMPACT;
+	}
+
+	return push_entry(uptime_ms, flags, summary, len);
+}
+
+/* Encode one queued entry into a batch, reading the sample straight from flash. The first entry
+ * sets the batch format; an entry in a different format ends the batch with -EAGAIN. A summary
+ * is copied without the batch entry wrapper and only ever as the first entry.
+ */
+static int encode_entry(uint8_t *buf, size_t buf_len, const struct fcb_entry *loc, bool prev_boot,
+			bool first, enum app_batch_format *format, bool *summary)
+{
+	struct sample_hdr hdr;
+	size_t sample_len = loc->fe_data_len - sizeof(hdr);
+	int64_t unix_ms = -1;
+	int64_t age_ms = -1;
+	int len;
+	int err;
+
+	err = flash_area_read(fcb.fap, FCB_ENTRY_FA_DATA_OFF((*loc)), &hdr, sizeof(hdr));
+	if (err) {
+		return err;
+	}
+
+	enum app_batch_format entry_format = (hdr.flags & SAMPLE_FLAG_COMPACT) ?
+						     APP_BATCH_FORMAT_COMPACT :
+						     APP_BATCH_FORMAT_STANDARD;
+
+	bool entry_summary = (hdr.flags & SAMPLE_FLAG_SUMMARY);
+
+	if (first) {
+		*format = entry_format;
+		*summary = entry_summary;
+	} else if ((entry_format != *format) || entry_summary) {
+		return -EAGAIN;
+	}
+
+	if (entry_summary) {
+		len = 0;
+	} else if (hdr.flags & SAMPLE_FLAG_TS_UNIX) {
+		unix_ms = hdr.ts_ms;
+	} else if (!prev_boot) {
+		/* Uptime from an earlier boot cannot be mapped onto wall clock time */
+		unix_ms = app_batch_uptime_to_unix_ms(hdr.ts_ms);
+		age_ms = k_uptime_get() - hdr.ts_ms;
+	}
+
+	if (!entry_summary) {
+		len = app_batch_put_entry_hdr(buf, buf_len, unix_ms, age_ms);
+		if (len < 0) {
+			return len;
+		}
+	}
+
+	if ((buf_len - len) < sample_len) {
+		return -ENOSPC;
+	}
+
+	err = flash_area_read(fcb.fap, FCB_ENTRY_FA_DATA_OFF((*loc)) + sizeof(hdr), &buf[len],
+			      sample_len);
+	if (err) {
+		return err;
+	}
+
+	return len + sample_len;
+}
+
+static void log_stats(void)
+{
+	LOG_INF("Sample queue: %u pending, %u uploaded, %u dropped, %u erases (%u/%u today)",
+		stats.pending, stats.uploaded, stats.dropped, stats.erases, stats.erases_in_window,
+		stats.erase_budget);
+}
+
+static void drain_work_handler(struct k_work *work);
+static K_WORK_DEFINE(drain_work, drain_work_handler);
+
+static void upload_done(struct golioth_client *client, enum golioth_status status,
+			const struct golioth_coap_rsp_code *coap_rsp_code, const char *path,
+			void *arg)
+{
+	/* Flash is only touched from the work item */
+	upload.status = status;
+	atomic_set(&upload.done, 1);
+	k_work_submit(&drain_work);
+}
+
+/* Read the next batch from flash and hand it to the Golioth client; call with the mutex held */
+static int start_upload(void)
+{
+	struct fcb_entry loc = cursor;
+	enum app_batch_format format = APP_BATCH_FORMAT_STANDARD;
+	uint32_t prev_boot = prev_boot_entries;
+	bool summary = false;
+	uint16_t count = 0;
+	uint8_t *batch_buf;
+	int err;
+
+	/* Array header is written last, once the number of entries is known */
+	size_t offset = APP_BATCH_ARRAY_HDR_LEN;
+
+	/* Samples stay queued until the next drain if the pool is busy */
+	upload.buf = app_uplink_buf_alloc(CONFIG_APP_SAMPLE_QUEUE_BATCH_SIZE);
+	if (!upload.buf) {
+		return -ENOMEM;
+	}
+
+	batch_buf = upload.buf->data;
+
+	while (fcb_getnext(&fcb, &loc) == 0) {
+		int len = encode_entry(&batch_buf[offset],
+				       CONFIG_APP_SAMPLE_QUEUE_BATCH_SIZE - offset, &loc,
+				       prev_boot > 0, count == 0, &format, &summary);
+
+		if ((len == -ENOSPC) || (len == -EAGAIN)) {
+			break;
+		}
+
+		if (len < 0) {
+			LOG_ERR("Failed to read queued sample: %d", len);
+			err = len;
+			goto release;
+		}
+
+		offset += len;
+		upload.last = loc;
+		count++;
+		prev_boot -= MIN(1, prev_boot);
+
+		if (summary || (count == UINT16_MAX)) {
+			break;
+		}
+	}
+
+	if (count == 0) {
+		/* Nothing left to upload */
+		err = -ENODATA;
+		goto release;
+	}
+
+	upload.count = count;
+	upload.prev_boot = prev_boot;
+	upload.stale = false;
+	atomic_clear(&upload.done);
+
+	if (summary) {
+		LOG_DBG("Uploading queued window summary (%zu bytes)",
+			offset - APP_BATCH_ARRAY_HDR_LEN);
+
+		err = golioth_stream_set_async(drain_client, app_batch_summary_path(format),
+					       GOLIOTH_CONTENT_TYPE_CBOR,
+					       &batch_buf[APP_BATCH_ARRAY_HDR_LEN],
+					       offset - APP_BATCH_ARRAY_HDR_LEN, upload_done, NULL);
+	} else {
+		app_batch_put_array_hdr(batch_buf, count);
+
+		LOG_DBG("Uploading batch of %u samples (%zu bytes)", count, offset);
+
+		err = golioth_stream_set_async(drain_client, app_batch_stream_path(format),
+					       GOLIOTH_CONTENT_TYPE_CBOR, batch_buf, offset,
+					       upload_done, NULL);
+	}
+	if (err == GOLIOTH_OK) {
+		return 0;
+	}
+
+	LOG_WRN("Failed to upload queued samples: %d", err);
+	err = -EIO;
+
+release:
+	net_buf_unref(upload.buf);
+	upload.buf = NULL;
+
+	return err;
+}
+
+/* Account for the batch in flight once Golioth has answered; call with the mutex held */
+static void finish_upload(void)
+{
+	if ((upload.status == GOLIOTH_OK) && upload.stale) {
+		/* Counted as dropped by the rotation; what is left of the batch goes again */
+		LOG_DBG("Queued samples uploaded after their sector was erased");
+	} else if (upload.status == GOLIOTH_OK) {
+		cursor = upload.last;
+		save_cursor();
+		prev_boot_entries = upload.prev_boot;
+		stats.pending -= MIN(upload.count, stats.pending);
+		stats.uploaded += upload.count;
+		drain_uploaded += upload.count;
+
+		release_uploaded_sectors();
+	} else {
+		LOG_WRN("Failed to upload queued samples: %d", upload.status);
+		drain_batches_left = 0;
+	}
+
+	net_buf_unref(upload.buf);
+	upload.buf = NULL;
+}
+
+static void drain_work_handler(struct k_work *work)
+{
+	k_mutex_lock(&queue_mutex, K_FOREVER);
+
+	if (upload.buf) {
+		if (!atomic_get(&upload.done)) {
+			/* Still waiting for Golioth; its answer resubmits this work */
+			goto unlock;
+		}
+
+		finish_upload();
+	}
+
+	if ((drain_batches_left > 0) && golioth_client_is_connected(drain_client)) {
+		drain_batches_left--;
+		if (start_upload() == 0) {
+			goto unlock;
+		}
+	}
+
+	drain_batches_left = 0;
+
+	if (drain_uploaded) {
+		log_stats();
+		drain_uploaded = 0;
+	}
+
+unlock:
+	k_mutex_unlock(&queue_mutex);
+}
+
+/// Upload queued samples in the background
+///
+/// Up to CONFIG_APP_SAMPLE_QUEUE_MAX_BATCHES_PER_DRAIN batches are sent from the system work
+/// queue, each once the previous one has been acknowledged; a failed upload ends the drain.
+///
+/// @retval 0 Drain started, already running or nothing to upload
+/// @retval -ENODEV Queue not initialized
+int app_sample_queue_drain(struct golioth_client *client)
+{
+	if (!initialized) {
+		return -ENODEV;
+	}
+
+	if (app_sample_queue_is_empty()) {
+		return 0;
+	}
+
+	k_mutex_lock(&queue_mutex, K_FOREVER);
+	drain_client = client;
+	drain_batches_left = CONFIG_APP_SAMPLE_QUEUE_MAX_BATCHES_PER_DRAIN;
+	k_mutex_unlock(&queue_mutex);
+
+	k_work_submit(&drain_work);
+
+	return 0;
+}
+
+bool app_sample_queue_is_empty(void)
+{
+	return stats.pending == 0;
+}
+
+void app_sample_queue_get_stats(struct app_sample_queue_stats *out)
+{
+	k_mutex_lock(&queue_mutex, K_FOREVER);
+	*out = stats;
+	k_mutex_unlock(&queue_mutex);
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __APP_SAMPLE_QUEUE_H__
+#define __APP_SAMPLE_QUEUE_H__
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <golioth/client.h>
+
+#include "app_batch.h"
+
+struct app_sample_queue_stats {
+	uint32_t pending;   /* samples stored in flash and not yet uploaded */
+	uint32_t appended;  /* samples written to flash since boot */
+	uint32_t uploaded;  /* samples acknowledged by Golioth since boot */
+	uint32_t dropped;   /* samples lost to a full queue or to rotation */
+	uint32_t erases;    /* flash sector erases since boot */
+	uint32_t erases_in_window; /* erases counted against the current budget window */
+	uint32_t erase_budget;     /* erases allowed per budget window */
+};
+
+#ifdef CONFIG_APP_SAMPLE_QUEUE
+
+int app_sample_queue_init(void);
+int app_sample_queue_push(int64_t uptime_ms, enum app_batch_format format, const uint8_t *sample,
+			  size_t len);
+int app_sample_queue_push_summary(int64_t uptime_ms, enum app_batch_format format,
+				  const uint8_t *summary, size_t len);
+int app_sample_queue_drain(struct golioth_client *client);
+bool app_sample_queue_is_empty(void);
+void app_sample_queue_get_stats(struct app_sample_queue_stats *stats);
+
+#else
+
+static inline int app_sample_queue_init(void)
+{
+	return 0;
+}
+
+static inline int app_sample_queue_push(int64_t uptime_ms, enum app_batch_format format,
+					const uint8_t *sample, size_t len)
+{
+	return -ENOTSUP;
+}
+
+static inline int app_sample_queue_push_summary(int64_t uptime_ms, enum app_batch_format format,
+						const uint8_t *summary, size_t len)
+{
+	return -ENOTSUP;
+}
+
+static inline int app_sample_queue_drain(struct golioth_client *client)
+{
+	return 0;
+}
+
+static inline bool app_sample_queue_is_empty(void)
+{
+	return true;
+}
+
+static inline void app_sample_queue_get_stats(struct app_sample_queue_stats *stats)
+{
+	*stats = (struct app_sample_queue_stats){0};
+}
+
+#endif /* CONFIG_APP_SAMPLE_QUEUE */
+
+#endif /* __APP_SAMPLE_QUEUE_H__ */
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(app_schedule, LOG_LEVEL_DBG);
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+#include "app_motion.h"
+#include "app_schedule.h"
+#include "app_sensors.h"
+#include "app_settings.h"
+
+/*
+ * Every sensor group has its own period. Nothing here runs on its own: the main loop sleeps until
+ * app_schedule_next_ms() and then reads whatever app_schedule_take_due() returns. Periods are
+ * looked up on every call, so setting changes and motion apply at the next deadline.
+ */
+
+/* The deadline each group was last read for; its next one is one period later */
+static int64_t last_due_ms[APP_SENSORS_GROUP_COUNT];
+static bool started;
+
+/* Deadline the main loop last went to sleep for */
+static int64_t planned_ms;
+static int64_t jitter_sum_ms;
+static int64_t cycle_start_ms;
+static int64_t cycle_sum_ms;
+static uint32_t cycle_count;
+static struct app_schedule_stats stats;
+static K_MUTEX_DEFINE(stats_mutex);
+
+static void record_wakeup(int64_t now_ms, uint32_t due, uint32_t skipped)
+{
+	k_mutex_lock(&stats_mutex, K_FOREVER);
+
+	stats.skipped += skipped;
+
+	if (due == 0) {
+		stats.on_demand++;
+	} else {
+		int32_t jitter_ms = (int32_t) MAX(now_ms - planned_ms, 0);
+
+		stats.cycles++;
+		jitter_sum_ms += jitter_ms;
+		stats.jitter_last_ms = jitter_ms;
+		stats.jitter_max_ms = MAX(stats.jitter_max_ms, jitter_ms);
+		stats.jitter_avg_ms = (int32_t) (jitter_sum_ms / stats.cycles);
+
+		LOG_DBG("Deadline wake-up for 0x%x, %d ms late", due, jitter_ms);
+	}
+
+	k_mutex_unlock(&stats_mutex);
+}
+
+static int64_t group_period_ms(enum app_sensors_group group)
+{
+	int32_t period_s = get_sensor_period_s(group);
+
+	if (period_s == 0) {
+		period_s = get_loop_delay_s();
+	}
+
+	if (app_motion_is_moving()) {
+		period_s = MIN(period_s, get_motion_fast_delay_s());
+	}
+
+	return (int64_t) period_s * MSEC_PER_SEC;
+}
+
+uint32_t app_schedule_take_due(int64_t now_ms)
+{
+	uint32_t skipped = 0;
+	uint32_t due = 0;
+
+	cycle_start_ms = now_ms;
+
+	if (!started) {
+		/* The first reading is taken on demand; schedules start from here */
+		for (int group = 0; group < APP_SENSORS_GROUP_COUNT; group++) {
+			last_due_ms[group] = now_ms;
+		}
+		started = true;
+		return 0;
+	}
+
+	for (int group = 0; group < APP_SENSORS_GROUP_COUNT; group++) {
+		if (!(APP_SENSORS_ALL & BIT(group))) {
+			continue;
+		}
+
+		int64_t period_ms = group_period_ms(group);
+		int64_t next_ms = last_due_ms[group] + period_ms;
+		int64_t window_ms = MIN(CONFIG_APP_SCHEDULE_COALESCE_MS, period_ms / 2);
+
+		if ((next_ms - window_ms) > now_ms) {
+			continue;
+		}
+
+		due |= BIT(group);
+
+		if (next_ms > now_ms) {
+			/* Pulled forward to share this wake-up */
+			last_due_ms[group] = next_ms;
+		} else {
+			/* Skip any periods missed entirely, but keep the phase */
+			int64_t missed = (now_ms - last_due_ms[group]) / period_ms;
+
+			skipped += missed - 1;
+			last_due_ms[group] += missed * period_ms;
+		}
+	}
+
+	record_wakeup(now_ms, due, skipped);
+
+	return due;
+}
+
+int64_t app_schedule_next_ms(void)
+{
+	int64_t now_ms = k_uptime_get();
+	int64_t next_ms = INT64_MAX;
+
+	for (int group = 0; group < APP_SENSORS_GROUP_COUNT; group++) {
+		if (!(APP_SENSORS_ALL & BIT(group))) {
+			continue;
+		}
+
+		next_ms = MIN(next_ms, last_due_ms[group] + group_period_ms(group));
+	}
+
+	int32_t cycle_ms = (int32_t) (now_ms - cycle_start_ms);
+
+	k_mutex_lock(&stats_mutex, K_FOREVER);
+	cycle_count++;
+	cycle_sum_ms += cycle_ms;
+	stats.cycle_last_ms = cycle_ms;
+	stats.cycle_max_ms = MAX(stats.cycle_max_ms, cycle_ms);
+	stats.cycle_avg_ms = (int32_t) (cycle_sum_ms / cycle_count);
+	k_mutex_unlock(&stats_mutex);
+
+	if (next_ms <= now_ms) {
+		k_mutex_lock(&stats_mutex, K_FOREVER);
+		stats.overruns++;
+		k_mutex_unlock(&stats_mutex);
+
+		LOG_WRN("Sensor cycle overran its next deadline by %d ms",
+			(int) (now_ms - next_ms));
+	}
+
+	planned_ms = next_ms;
+
+	return next_ms;
+}
+
+void app_schedule_get_stats(struct app_schedule_stats *out)
+{
+	k_mutex_lock(&stats_mutex, K_FOREVER);
+	*out = stats;
+	k_mutex_unlock(&stats_mutex);
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __APP_SCHEDULE_H__
+#define __APP_SCHEDULE_H__
+
+#include <stdint.h>
+
+struct app_schedule_stats {
+	uint32_t cycles;         /* wake-ups at a deadline */
+	uint32_t on_demand;      /* wake-ups before any deadline (button, motion, settings) */
+	uint32_t overruns;       /* cycles that finished after the next deadline had passed */
+	uint32_t skipped;        /* whole periods dropped to catch up after an overrun */
+	int32_t jitter_last_ms;  /* how late the last deadline wake-up started */
+	int32_t jitter_max_ms;
+	int32_t jitter_avg_ms;
+	int32_t cycle_last_ms;   /* from app_schedule_take_due() to app_schedule_next_ms() */
+	int32_t cycle_max_ms;
+	int32_t cycle_avg_ms;
+};
+
+/**
+ * Claim every sensor group that is due at now_ms
+ *
+ * Groups due within CONFIG_APP_SCHEDULE_COALESCE_MS of now_ms are claimed as well, so nearby
+ * readings share one wake-up and one uplink. Each claimed group's deadline advances by whole
+ * periods from its previous deadline, so the schedule does not drift.
+ *
+ * @retval Bitmask of BIT(enum app_sensors_group); 0 if nothing is due yet
+ */
+uint32_t app_schedule_take_due(int64_t now_ms);
+
+/* Uptime in ms of the earliest upcoming deadline; call once per cycle, right before sleeping */
+int64_t app_schedule_next_ms(void);
+
+void app_schedule_get_stats(struct app_schedule_stats *stats);
+
+#endif /* __APP_SCHEDULE_H__ */
@@ -8,31 +8,283 @@
 LOG_MODULE_REGISTER(app_sensors, LOG_LEVEL_DBG);
 
 #include <stdlib.h>
+#include <string.h>
 #include <golioth/client.h>
 #include <golioth/stream.h>
 #include <zcbor_encode.h>
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/drivers/sensor.h>
 #include <zephyr/device.h>
+#include <zephyr/net_buf.h>
+#include <zephyr/sys/atomic.h>
 
+#include "app_aggregate.h"
+#include "app_batch.h"
+#include "app_boot.h"
+#include "app_fixed.h"
+#include "app_radio.h"
+#include "app_sample_queue.h"
 #include "app_sensors.h"
 #include "app_settings.h"
+#include "app_uplink_buf.h"
+#include "app_vibration.h"
+#include "main.h"
 
 static struct golioth_client *client;
 
+#ifdef CONFIG_APP_SENSORS_BENCHMARK
+/* Where the last app_sensors_read_and_stream() spent its time, in benchmark clock units */
+struct cycle_timing {
+	uint32_t start;
+	uint32_t fetched;
+	uint32_t encoded;
+	uint32_t enqueued;
+	int len; /* encoded sample size, or 0 if nothing was sent */
+};
+
+static struct cycle_timing timing;
+
+#if defined(CONFIG_BOARD_NATIVE_SIM)
+/* Simulated time stands still while native_sim runs code, so time it on the host instead */
+uint64_t app_bench_host_cpu_ns(void);
+
+static inline uint32_t bench_stamp(void)
+{
+	return (uint32_t) app_bench_host_cpu_ns();
+}
+
+static inline uint64_t bench_to_ns(uint32_t delta)
+{
+	return delta;
+}
+
+static inline void bench_init(void)
+{
+}
+#elif defined(CONFIG_TIMING_FUNCTIONS)
+#include <zephyr/timing/timing.h>
+
+/* CPU cycles, from the DWT cycle counter on Cortex-M */
+#define BENCH_COUNTS_CYCLES 1
+
+static inline uint32_t bench_stamp(void)
+{
+	return (uint32_t) timing_counter_get();
+}
+
+static inline uint64_t bench_to_ns(uint32_t delta)
+{
+	return timing_cycles_to_ns(delta);
+}
+
+static inline void bench_init(void)
+{
+	timing_init();
+	timing_start();
+}
+#else
+static inline uint32_t bench_stamp(void)
+{
+	return k_cycle_get_32();
+}
+
+static inline uint64_t bench_to_ns(uint32_t delta)
+{
+	return k_cyc_to_ns_floor64(delta);
+}
+
+static inline void bench_init(void)
+{
+}
+#endif /* CONFIG_BOARD_NATIVE_SIM */
+
+#define TIMING_MARK(field) (timing.field = bench_stamp())
+#else
+#define TIMING_MARK(field)
+#endif /* CONFIG_APP_SENSORS_BENCHMARK */
+
+/* Upper bound on waiting for the LED thread; normally it answers within a scheduler tick */
+#define LED_QUIESCE_TIMEOUT_MS 100
+
+/* Largest encoded sample */
+#define SAMPLE_MAX_LEN 256
+
+/* Largest window summary: every channel as a key and five values, plus group keys */
+#define SUMMARY_MAX_LEN 512
+
+/*
+ * Samples are encoded straight into the open batch buffer, each behind a gap of
+ * APP_BATCH_ENTRY_HDR_MAX_LEN bytes for its entry header. The headers are filled in when the
+ * batch is sent; the samples only move if a header came out shorter than its gap. Past
+ * BATCH_BUF_SIZE there is room for the one sample that overflows it and starts the next batch.
+ */
+#define BATCH_ALLOC_LEN                                                                   \
+	(APP_BATCH_ARRAY_HDR_LEN + CONFIG_APP_SENSORS_BATCH_BUF_SIZE + SAMPLE_MAX_LEN +   \
+	 (CONFIG_APP_SENSORS_BATCH_MAX_SAMPLES * APP_BATCH_ENTRY_HDR_MAX_LEN))
+
+/* Samples held in RAM until a batch threshold is reached */
+struct batch_sample {
+	uint32_t offset_ms; /* time since the first sample in the batch */
+	uint16_t pos;       /* start of the sample in batch_buf->data */
+	uint16_t len;
+};
+
+static struct net_buf *batch_buf; /* taken from the uplink pool while a batch is open */
+static struct batch_sample batch_samples[CONFIG_APP_SENSORS_BATCH_MAX_SAMPLES];
+static size_t batch_used; /* sample bytes, without entry headers */
+static uint8_t batch_count;
+static int64_t batch_start_ms;
+static enum app_batch_format batch_format;
+static bool batch_split; /* only held for the radio; samples go out one by one */
+static int64_t batch_max_age_ms;
+static atomic_t batch_age_expired;
+
 /* Sensor device structs */
-#if defined(CONFIG_BOARD_THINGY91_NRF9160_NS)
+#if defined(CONFIG_APP_SENSORS_THINGY91)
 const struct device *light = DEVICE_DT_GET_ONE(rohm_bh1749);
 const struct device *weather = DEVICE_DT_GET_ONE(bosch_bme680);
 const struct device *accel = DEVICE_DT_GET_ONE(adi_adxl362);
 #endif
 
-#if defined(CONFIG_BOARD_THINGY91X_NRF9151_NS)
+#if defined(CONFIG_APP_SENSORS_THINGY91X)
 #include <drivers/bme68x_iaq.h>
 const struct device *weather = DEVICE_DT_GET_ONE(bosch_bme680);
 const struct device *accel = DEVICE_DT_GET_ONE(adi_adxl367);
 #endif
 
+enum sensors_channel {
+#if defined(CONFIG_DT_HAS_ROHM_BH1749_ENABLED)
+	CH_LIGHT_RED,
+	CH_LIGHT_GREEN,
+	CH_LIGHT_BLUE,
+	CH_LIGHT_IR,
+#endif
+	CH_WEATHER_TEM,
+	CH_WEATHER_PRE,
+	CH_WEATHER_HUM,
+#if defined(CONFIG_APP_SENSORS_THINGY91)
+	CH_WEATHER_GAS,
+#elif defined(CONFIG_APP_SENSORS_THINGY91X)
+	CH_WEATHER_IAQ,
+	CH_WEATHER_CO2,
+	CH_WEATHER_VOC,
+#endif
+	CH_ACCEL_X,
+	CH_ACCEL_Y,
+	CH_ACCEL_Z,
+	CH_COUNT
+};
+
+/* How a channel is written in the compact encoding */
+enum compact_format {
+	COMPACT_UINT,
+	COMPACT_INT,
+	COMPACT_FLOAT16,
+	COMPACT_FLOAT32,
+};
+
+struct group_desc {
+	const char *key;
+	uint8_t compact_key;
+};
+
+struct channel_desc {
+	enum app_sensors_group group;
+	enum sensor_channel chan;
+	const char *key;
+	uint8_t compact_key;
+	enum compact_format compact;
+	enum app_deadband deadband;
+	uint8_t decimals; /* digits kept after the point when aggregating, at most 3 */
+};
+
+/* Compact keys must match pipelines/cbor-compact-*.yml */
+static const struct group_desc groups[APP_SENSORS_GROUP_COUNT] = {
+	[APP_SENSORS_LIGHT] = {"light", 1},
+	[APP_SENSORS_WEATHER] = {"weather", 2},
+	[APP_SENSORS_ACCEL] = {"accel", 3},
+};
+
+static const struct channel_desc channels[CH_COUNT] = {
+#if defined(CONFIG_DT_HAS_ROHM_BH1749_ENABLED)
+	[CH_LIGHT_RED] = {APP_SENSORS_LIGHT, SENSOR_CHAN_RED, "red", 1, COMPACT_UINT,
+			  APP_DEADBAND_LIGHT, 0},
+	[CH_LIGHT_GREEN] = {APP_SENSORS_LIGHT, SENSOR_CHAN_GREEN, "green", 2, COMPACT_UINT,
+			    APP_DEADBAND_LIGHT, 0},
+	[CH_LIGHT_BLUE] = {APP_SENSORS_LIGHT, SENSOR_CHAN_BLUE, "blue", 3, COMPACT_UINT,
+			   APP_DEADBAND_LIGHT, 0},
+	[CH_LIGHT_IR] = {APP_SENSORS_LIGHT, SENSOR_CHAN_IR, "ir", 4, COMPACT_UINT,
+			 APP_DEADBAND_LIGHT, 0},
+#endif
+	[CH_WEATHER_TEM] = {APP_SENSORS_WEATHER, SENSOR_CHAN_AMBIENT_TEMP, "tem", 1,
+			    COMPACT_FLOAT32, APP_DEADBAND_TEM, 3},
+	[CH_WEATHER_PRE] = {APP_SENSORS_WEATHER, SENSOR_CHAN_PRESS, "pre", 2, COMPACT_FLOAT32,
+			    APP_DEADBAND_PRE, 3},
+	[CH_WEATHER_HUM] = {APP_SENSORS_WEATHER, SENSOR_CHAN_HUMIDITY, "hum", 3, COMPACT_FLOAT32,
+			    APP_DEADBAND_HUM, 3},
+#if defined(CONFIG_APP_SENSORS_THINGY91)
+	[CH_WEATHER_GAS] = {APP_SENSORS_WEATHER, SENSOR_CHAN_GAS_RES, "gas", 4, COMPACT_UINT,
+			    APP_DEADBAND_GAS, 0},
+#elif defined(CONFIG_APP_SENSORS_THINGY91X)
+	/* IAQ is the one channel sent as an integer in the standard encoding too */
+	[CH_WEATHER_IAQ] = {APP_SENSORS_WEATHER, SENSOR_CHAN_IAQ, "iaq", 5, COMPACT_INT,
+			    APP_DEADBAND_IAQ, 0},
+	[CH_WEATHER_CO2] = {APP_SENSORS_WEATHER, SENSOR_CHAN_CO2, "co2", 6, COMPACT_FLOAT32,
+			    APP_DEADBAND_CO2, 1},
+	[CH_WEATHER_VOC] = {APP_SENSORS_WEATHER, SENSOR_CHAN_VOC, "voc", 7, COMPACT_FLOAT32,
+			    APP_DEADBAND_VOC, 3},
+#endif
+	/* The accelerometer's noise floor is well above float16 resolution */
+	[CH_ACCEL_X] = {APP_SENSORS_ACCEL, SENSOR_CHAN_ACCEL_X, "x", 1, COMPACT_FLOAT16,
+			APP_DEADBAND_ACCEL, 3},
+	[CH_ACCEL_Y] = {APP_SENSORS_ACCEL, SENSOR_CHAN_ACCEL_Y, "y", 2, COMPACT_FLOAT16,
+			APP_DEADBAND_ACCEL, 3},
+	[CH_ACCEL_Z] = {APP_SENSORS_ACCEL, SENSOR_CHAN_ACCEL_Z, "z", 3, COMPACT_FLOAT16,
+			APP_DEADBAND_ACCEL, 3},
+};
+
+/* One reading of every sensor, kept separate from how it is encoded */
+struct sensors_sample {
+	struct sensor_value values[CH_COUNT];
+	bool valid[CH_COUNT];  /* read from the sensor this cycle */
+	bool report[CH_COUNT]; /* to be encoded and sent */
+};
+
+/* Last value reported for each channel, the reference for its deadband */
+static int64_t last_sent_micro[CH_COUNT];
+static bool last_sent_valid[CH_COUNT];
+static int32_t cycles_since_keepalive;
+
+/* Running statistics for the open summary window, when AGGREGATE_WINDOW_S is set */
+static struct app_aggregate window_stats[CH_COUNT];
+static int64_t window_start_ms;
+static bool window_open;
+
+static void get_group_channels(const struct device *dev, enum app_sensors_group group,
+			       struct sensors_sample *sample)
+{
+	for (int ch = 0; ch < CH_COUNT; ch++) {
+		if (channels[ch].group != group) {
+			continue;
+		}
+
+		int err = sensor_channel_get(dev, channels[ch].chan, &sample->values[ch]);
+
+		sample->valid[ch] = (err == 0);
+	}
+}
+
+static atomic_t uplink_sent;
+static atomic_t uplink_failed;
+static atomic_t uplink_queued;
+static atomic_t uplink_dropped;
+
+/* The benchmark runs with no client at all, which is the same as being offline */
+static bool client_connected(void)
+{
+	return client && golioth_client_is_connected(client);
+}
+
 /* Callback for LightDB Stream */
 static void async_error_handler(struct golioth_client *client, enum golioth_status status,
 				const struct golioth_coap_rsp_code *coap_rsp_code, const char *path,
@@ -40,302 +292,1137 @@ static void async_error_handler(struct golioth_client *client, enum golioth_stat
 {
 	if (status != GOLIOTH_OK) {
 		LOG_ERR("Async task failed: %d", status);
+		atomic_inc(&uplink_failed);
 		return;
 	}
+
+	atomic_inc(&uplink_sent);
+	app_boot_mark(APP_BOOT_FIRST_ACK);
 }
 
-static enum golioth_status read_light_sensor(zcbor_state_t *zse)
+/* Requests the client accepted are counted once Golioth answers them */
+static void count_stream_result(int err)
 {
-#if defined(CONFIG_DT_HAS_ROHM_BH1749_ENABLED)
+	if (err) {
+		atomic_inc(&uplink_failed);
+	}
+}
 
-	struct sensor_value BH1749_RED;
-	struct sensor_value BH1749_GREEN;
-	struct sensor_value BH1749_BLUE;
-	struct sensor_value BH1749_IR;
-	bool ok;
+static void count_queue_result(int err)
+{
+	atomic_inc(err ? &uplink_dropped : &uplink_queued);
+}
+
+void app_sensors_get_uplink_stats(struct app_sensors_uplink_stats *stats)
+{
+	stats->sent = atomic_get(&uplink_sent);
+	stats->failed = atomic_get(&uplink_failed);
+	stats->queued = atomic_get(&uplink_queued);
+	stats->dropped = atomic_get(&uplink_dropped);
+}
+
+static int fetch_light_sensor(struct sensors_sample *sample)
+{
+#if defined(CONFIG_DT_HAS_ROHM_BH1749_ENABLED)
 
 	/* Turn off LED so light sensor won't detect LED fade
 	 * Also helps highlight that there is a reading being taken.
 	 */
-	all_leds_off();
+	int err = all_leds_off_sync(K_MSEC(LED_QUIESCE_TIMEOUT_MS));
 
-	/* briefly sleep the thread to give time to run the LED thread */
-	k_msleep(300);
+	if (err) {
+		LOG_WRN("LEDs not confirmed off, light reading may include them");
+	}
 
 	/* Start taking readings */
 
 	/* BH1749 */
-	int err = sensor_sample_fetch(light);
+	err = sensor_sample_fetch(light);
 
 	all_leds_on();
 
 	if (err) {
 		LOG_ERR("Error fetching BH1749 sensor sample: %d", err);
-		return GOLIOTH_ERR_FAIL;
+		return err;
 	}
-	sensor_channel_get(light, SENSOR_CHAN_RED, &BH1749_RED);
-	sensor_channel_get(light, SENSOR_CHAN_GREEN, &BH1749_GREEN);
-	sensor_channel_get(light, SENSOR_CHAN_BLUE, &BH1749_BLUE);
-	sensor_channel_get(light, SENSOR_CHAN_IR, &BH1749_IR);
-	LOG_DBG("R: %d, G: %d, B: %d, IR: %d", BH1749_RED.val1, BH1749_GREEN.val1, BH1749_BLUE.val1,
-		BH1749_IR.val1);
 
-	ok = zcbor_tstr_put_lit(zse, "light") && zcbor_map_start_encode(zse, 4);
-	if (!ok)
-	{
-		LOG_ERR("ZCBOR unable to open light map");
-		return GOLIOTH_ERR_QUEUE_FULL;
-	}
-
-	ok = zcbor_tstr_put_lit(zse, "red") &&
-	     zcbor_float64_put(zse, sensor_value_to_double(&BH1749_RED)) &&
-	     zcbor_tstr_put_lit(zse, "green") &&
-	     zcbor_float64_put(zse, sensor_value_to_double(&BH1749_GREEN)) &&
-	     zcbor_tstr_put_lit(zse, "blue") &&
-	     zcbor_float64_put(zse, sensor_value_to_double(&BH1749_BLUE)) &&
-	     zcbor_tstr_put_lit(zse, "ir") &&
-	     zcbor_float64_put(zse, sensor_value_to_double(&BH1749_IR));
-	if (!ok)
-	{
-		LOG_ERR("ZCBOR failed to encode light data");
-		return GOLIOTH_ERR_QUEUE_FULL;
+	get_group_channels(light, APP_SENSORS_LIGHT, sample);
+	LOG_DBG("R: %d, G: %d, B: %d, IR: %d", sample->values[CH_LIGHT_RED].val1,
+		sample->values[CH_LIGHT_GREEN].val1, sample->values[CH_LIGHT_BLUE].val1,
+		sample->values[CH_LIGHT_IR].val1);
+
+	return 0;
+
+#else
+
+	return -ENODEV;
+
+#endif /* CONFIG_DT_HAS_ROHM_BH1749_ENABLED */
+}
+
+static int fetch_weather_sensor(struct sensors_sample *sample)
+{
+	/* BME680 */
+	int err = sensor_sample_fetch(weather);
+	if (err) {
+		LOG_ERR("Error fetching BME680 sensor sample: %d", err);
+		return err;
 	}
 
-	ok = zcbor_map_end_encode(zse, 4);
-	if (!ok)
-	{
-		LOG_ERR("ZCBOR failed to close light map");
-		return GOLIOTH_ERR_QUEUE_FULL;
+	get_group_channels(weather, APP_SENSORS_WEATHER, sample);
+
+	struct sensor_value *temp = &sample->values[CH_WEATHER_TEM];
+	struct sensor_value *press = &sample->values[CH_WEATHER_PRE];
+	struct sensor_value *humidity = &sample->values[CH_WEATHER_HUM];
+
+	LOG_DBG("T: %d.%06d; P: %d.%06d; H: %d.%06d", temp->val1, abs(temp->val2), press->val1,
+		press->val2, humidity->val1, humidity->val2);
+
+#if defined(CONFIG_APP_SENSORS_THINGY91)
+	struct sensor_value *gas_res = &sample->values[CH_WEATHER_GAS];
+
+	LOG_DBG("G: %d.%06d", gas_res->val1, gas_res->val2);
+#elif defined(CONFIG_APP_SENSORS_THINGY91X)
+	struct sensor_value *gas_co2 = &sample->values[CH_WEATHER_CO2];
+	struct sensor_value *gas_voc = &sample->values[CH_WEATHER_VOC];
+
+	LOG_DBG("IAQ: %d; CO2: %d.%06d; VOC: %d.%06d", sample->values[CH_WEATHER_IAQ].val1,
+		gas_co2->val1, gas_co2->val2, gas_voc->val1, gas_voc->val2);
+#endif
+
+	return 0;
+}
+
+static int fetch_accel_sensor(struct sensors_sample *sample)
+{
+	/* ADXL362 */
+	int err = sensor_sample_fetch(accel);
+	if (err) {
+		LOG_ERR("Error fetching ADXL362 sensor sample: %d", err);
+		return err;
 	}
 
-	return GOLIOTH_OK;
+	get_group_channels(accel, APP_SENSORS_ACCEL, sample);
 
-#else
+	struct sensor_value *accel_x = &sample->values[CH_ACCEL_X];
+	struct sensor_value *accel_y = &sample->values[CH_ACCEL_Y];
+	struct sensor_value *accel_z = &sample->values[CH_ACCEL_Z];
 
-	return GOLIOTH_OK;
+	LOG_DBG("X: %d.%06d; Y: %d.%06d; Z: %d.%06d", accel_x->val1, abs(accel_x->val2),
+		accel_y->val1, abs(accel_y->val2), accel_z->val1, abs(accel_z->val2));
 
-#endif /* CONFIG_DT_HAS_ROHM_BH1749_ENABLED */
+	return 0;
 }
 
+static bool outside_deadband(const struct app_config *cfg, int ch, int64_t value_micro)
+{
+	int64_t last = last_sent_micro[ch];
+	int64_t band = cfg->deadband_micro[channels[ch].deadband];
+	int64_t rel_band = (llabs(last) / 100) * cfg->deadband_rel_pct;
+
+	return llabs(value_micro - last) > MAX(band, rel_band);
+}
 
-/* This function assume that sensor_sample_fetch() has already been run */
-static enum golioth_status process_gas_sensor(zcbor_state_t *zse)
+/// Decide which channels of a sample to report
+///
+/// A channel is reported when it has moved further from its last reported value than the
+/// larger of its absolute deadband and DEADBAND_REL_PCT of that value. Every
+/// DEADBAND_KEEPALIVE cycles all channels are reported regardless, so the cloud can tell a
+/// quiet device from a silent one.
+///
+/// @retval Number of channels to report
+static int apply_deadband(const struct app_config *cfg, struct sensors_sample *sample)
 {
-#if defined(CONFIG_BOARD_THINGY91_NRF9160_NS)
+	bool keepalive = (++cycles_since_keepalive >= cfg->deadband_keepalive);
+	int count = 0;
 
-	struct sensor_value gas_res;
-	bool ok;
+	if (keepalive) {
+		cycles_since_keepalive = 0;
+	}
 
-	sensor_channel_get(weather, SENSOR_CHAN_GAS_RES, &gas_res);
-	LOG_DBG("G: %d.%06d", gas_res.val1, gas_res.val2);
+	for (int ch = 0; ch < CH_COUNT; ch++) {
+		if (!sample->valid[ch]) {
+			continue;
+		}
 
-	ok = zcbor_tstr_put_lit(zse, "gas") &&
-	     zcbor_float64_put(zse, sensor_value_to_double(&gas_res));
+		int64_t value_micro = sensor_value_to_micro(&sample->values[ch]);
 
-	if (!ok)
-	{
-		LOG_ERR("ZCBOR unable to encode gas data");
-		return GOLIOTH_ERR_QUEUE_FULL;
+		if (keepalive || !last_sent_valid[ch] || outside_deadband(cfg, ch, value_micro)) {
+			sample->report[ch] = true;
+			last_sent_micro[ch] = value_micro;
+			last_sent_valid[ch] = true;
+			count++;
+		}
 	}
 
-	return GOLIOTH_OK;
+	if (!keepalive) {
+		LOG_DBG("%d of %d channels outside deadband", count, CH_COUNT);
+	}
 
-#elif defined(CONFIG_BOARD_THINGY91X_NRF9151_NS)
+	return count;
+}
 
-	struct sensor_value gas_iaq = { 0 };
-	struct sensor_value gas_co2 = { 0 };
-	struct sensor_value gas_voc = { 0 };
-	bool ok;
+/* Each sensor group is fetched by its own work item so slow conversions can overlap */
+struct fetch_job {
+	struct k_work work;
+	int (*fetch)(struct sensors_sample *sample);
+	const char *name;
+	struct sensors_sample *sample;
+	uint32_t duration_us;
+};
 
-	sensor_channel_get(weather, SENSOR_CHAN_IAQ, &gas_iaq);
-	sensor_channel_get(weather, SENSOR_CHAN_CO2, &gas_co2);
-	sensor_channel_get(weather, SENSOR_CHAN_VOC, &gas_voc);
-	LOG_DBG("IAQ: %d; CO2: %d.%06d; VOC: %d.%06d",
-		gas_iaq.val1, gas_co2.val1, gas_co2.val2, gas_voc.val1, gas_voc.val2);
+static struct fetch_job fetch_jobs[APP_SENSORS_GROUP_COUNT] = {
+	[APP_SENSORS_LIGHT] = {.fetch = fetch_light_sensor, .name = "light"},
+	[APP_SENSORS_WEATHER] = {.fetch = fetch_weather_sensor, .name = "weather"},
+	[APP_SENSORS_ACCEL] = {.fetch = fetch_accel_sensor, .name = "accel"},
+};
 
-	ok = zcbor_tstr_put_lit(zse, "iaq") &&
-	     zcbor_int32_put(zse, gas_iaq.val1) &&
-	     zcbor_tstr_put_lit(zse, "co2") &&
-	     zcbor_float64_put(zse, sensor_value_to_double(&gas_co2)) &&
-	     zcbor_tstr_put_lit(zse, "voc") &&
-	     zcbor_float64_put(zse, sensor_value_to_double(&gas_voc));
+#if defined(CONFIG_APP_SENSORS_CONCURRENT_FETCH)
+static K_THREAD_STACK_ARRAY_DEFINE(fetch_stacks, APP_SENSORS_GROUP_COUNT,
+				   CONFIG_APP_SENSORS_FETCH_STACK_SIZE);
+static struct k_work_q fetch_queues[APP_SENSORS_GROUP_COUNT];
+#endif
 
-	if (!ok)
-	{
-		LOG_ERR("ZCBOR unable to encode gas data");
-		return GOLIOTH_ERR_QUEUE_FULL;
+static void fetch_work_handler(struct k_work *work)
+{
+	struct fetch_job *job = CONTAINER_OF(work, struct fetch_job, work);
+	uint32_t start = k_cycle_get_32();
+
+	/* Errors are logged by the fetch function; its channels stay invalid */
+	job->fetch(job->sample);
+	job->duration_us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+}
+
+static void fetch_jobs_init(void)
+{
+	static bool initialized;
+
+	if (initialized) {
+		return;
 	}
 
-	return GOLIOTH_OK;
+	for (int group = 0; group < APP_SENSORS_GROUP_COUNT; group++) {
+		k_work_init(&fetch_jobs[group].work, fetch_work_handler);
+
+#if defined(CONFIG_APP_SENSORS_CONCURRENT_FETCH)
+		struct k_work_queue_config cfg = {.name = fetch_jobs[group].name};
+
+		k_work_queue_start(&fetch_queues[group], fetch_stacks[group],
+				   K_THREAD_STACK_SIZEOF(fetch_stacks[group]),
+				   CONFIG_MAIN_THREAD_PRIORITY, &cfg);
+#endif
+	}
+
+	initialized = true;
+}
+
+/* Read the requested sensor groups into sample; returns once all of them have finished */
+static void fetch_sensors(uint32_t groups, struct sensors_sample *sample)
+{
+	uint32_t start = k_cycle_get_32();
 
+	fetch_jobs_init();
+
+	for (int group = 0; group < APP_SENSORS_GROUP_COUNT; group++) {
+		fetch_jobs[group].sample = sample;
+		fetch_jobs[group].duration_us = 0;
+
+		if (!(groups & BIT(group))) {
+			continue;
+		}
+
+#if defined(CONFIG_APP_SENSORS_CONCURRENT_FETCH)
+		k_work_submit_to_queue(&fetch_queues[group], &fetch_jobs[group].work);
 #else
+		fetch_work_handler(&fetch_jobs[group].work);
+#endif
+	}
 
-	return GOLIOTH_OK;
+#if defined(CONFIG_APP_SENSORS_CONCURRENT_FETCH)
+	for (int group = 0; group < APP_SENSORS_GROUP_COUNT; group++) {
+		struct k_work_sync sync;
 
+		k_work_flush(&fetch_jobs[group].work, &sync);
+	}
 #endif
+
+	LOG_DBG("Sensors 0x%x read in %u us (light %u us, weather %u us, accel %u us)", groups,
+		k_cyc_to_us_floor32(k_cycle_get_32() - start),
+		fetch_jobs[APP_SENSORS_LIGHT].duration_us,
+		fetch_jobs[APP_SENSORS_WEATHER].duration_us,
+		fetch_jobs[APP_SENSORS_ACCEL].duration_us);
 }
-static enum golioth_status read_weather_sensor(zcbor_state_t *zse)
+
+/* The zcbor float encoders take their input by pointer and copy its bits, so values built by
+ * app_fixed.c reach the buffer without any double precision arithmetic.
+ */
+union float_bits {
+	uint64_t f64;
+	uint32_t f32;
+	double d;
+	float f;
+};
+
+static bool encode_channel(zcbor_state_t *zse, const struct channel_desc *desc,
+			   const struct sensor_value *val, enum app_batch_format format)
 {
-	struct sensor_value temp;
-	struct sensor_value press;
-	struct sensor_value humidity;
+	union float_bits bits;
+
+	if (format == APP_BATCH_FORMAT_STANDARD) {
+		if (!zcbor_tstr_put_term(zse, desc->key, SIZE_MAX)) {
+			return false;
+		}
+
+		if (desc->compact == COMPACT_INT) {
+			return zcbor_int32_put(zse, val->val1);
+		}
+
+		bits.f64 = app_fixed_micro_to_f64(sensor_value_to_micro(val));
+		return zcbor_float64_encode(zse, &bits.d);
+	}
+
+	if (!zcbor_uint32_put(zse, desc->compact_key)) {
+		return false;
+	}
+
+	switch (desc->compact) {
+	case COMPACT_UINT:
+		return zcbor_uint32_put(zse, MAX(val->val1, 0));
+	case COMPACT_INT:
+		return zcbor_int32_put(zse, val->val1);
+	case COMPACT_FLOAT16:
+		bits.f32 = app_fixed_micro_to_f32(sensor_value_to_micro(val));
+		return zcbor_float16_encode(zse, &bits.f);
+	case COMPACT_FLOAT32:
+	default:
+		bits.f32 = app_fixed_micro_to_f32(sensor_value_to_micro(val));
+		return zcbor_float32_encode(zse, &bits.f);
+	}
+}
+
+static bool encode_group(zcbor_state_t *zse, enum app_sensors_group group,
+			 const struct sensors_sample *sample, enum app_batch_format format)
+{
+	const struct group_desc *desc = &groups[group];
+	/* The compact pipelines move every key, so compact samples list all channels */
+	bool all = (format == APP_BATCH_FORMAT_COMPACT);
+	size_t count = 0;
 	bool ok;
-	enum golioth_status status;
 
-	/* BME680 */
-	int err = sensor_sample_fetch(weather);
-	if (err) {
-		LOG_ERR("Error fetching BME680 sensor sample: %d", err);
-		return GOLIOTH_ERR_FAIL;
+	for (int ch = 0; ch < CH_COUNT; ch++) {
+		if ((channels[ch].group == group) && (all || sample->report[ch])) {
+			count++;
+		}
 	}
-	sensor_channel_get(weather, SENSOR_CHAN_AMBIENT_TEMP, &temp);
-	sensor_channel_get(weather, SENSOR_CHAN_PRESS, &press);
-	sensor_channel_get(weather, SENSOR_CHAN_HUMIDITY, &humidity);
-	LOG_DBG("T: %d.%06d; P: %d.%06d; H: %d.%06d", temp.val1, abs(temp.val2), press.val1,
-		press.val2, humidity.val1, humidity.val2);
 
-	ok = zcbor_tstr_put_lit(zse, "weather") && zcbor_map_start_encode(zse, 4);
-	if (!ok)
-	{
-		LOG_ERR("ZCBOR unable to open weather map");
-		return GOLIOTH_ERR_QUEUE_FULL;
+	if (count == 0) {
+		return true;
+	}
+
+	if (format == APP_BATCH_FORMAT_STANDARD) {
+		ok = zcbor_tstr_put_term(zse, desc->key, SIZE_MAX);
+	} else {
+		ok = zcbor_uint32_put(zse, desc->compact_key);
+	}
+
+	ok = ok && zcbor_map_start_encode(zse, count);
+	if (!ok) {
+		LOG_ERR("ZCBOR unable to open %s map", desc->key);
+		return false;
+	}
+
+	for (int ch = 0; ch < CH_COUNT; ch++) {
+		if ((channels[ch].group != group) || !(all || sample->report[ch])) {
+			continue;
+		}
+
+		if (sample->report[ch]) {
+			ok = encode_channel(zse, &channels[ch], &sample->values[ch], format);
+		} else {
+			/* Not read, failed or within its deadband */
+			ok = zcbor_uint32_put(zse, channels[ch].compact_key) &&
+			     zcbor_nil_put(zse, NULL);
+		}
+		if (!ok) {
+			LOG_ERR("ZCBOR failed to encode %s data", desc->key);
+			return false;
+		}
+	}
+
+	ok = zcbor_map_end_encode(zse, count);
+	if (!ok) {
+		LOG_ERR("ZCBOR failed to close %s map", desc->key);
+		return false;
 	}
 
-	ok = zcbor_tstr_put_lit(zse, "tem") &&
-	     zcbor_float64_put(zse, sensor_value_to_double(&temp)) &&
-	     zcbor_tstr_put_lit(zse, "pre") &&
-	     zcbor_float64_put(zse, sensor_value_to_double(&press)) &&
-	     zcbor_tstr_put_lit(zse, "hum") &&
-	     zcbor_float64_put(zse, sensor_value_to_double(&humidity));
+	return true;
+}
+
+/// Encode a sample as a CBOR map of sensor groups
+///
+/// In the standard format only channels marked for reporting are written and groups with none
+/// are left out. The compact format writes every channel, with nil for those not reported. The
+/// standard format uses text keys and float64 values. The compact format uses the small
+/// integer keys from the channel table, plain integers for integer channels and half or single
+/// precision floats for the rest; pipelines/cbor-compact-*.yml restore the standard shape.
+///
+/// @retval Number of bytes written to buf or -ENOMEM
+static int encode_sample(const struct sensors_sample *sample, enum app_batch_format format,
+			 uint8_t *buf, size_t buf_len)
+{
+	bool ok;
+
+	ZCBOR_STATE_E(zse, 3, buf, buf_len, 1);
+
+	ok = zcbor_map_start_encode(zse, APP_SENSORS_GROUP_COUNT);
+
 	if (!ok)
 	{
-		LOG_ERR("ZCBOR failed to encode weather data");
-		return GOLIOTH_ERR_QUEUE_FULL;
+		LOG_ERR("ZCBOR failed to open map");
+		return -ENOMEM;
 	}
 
-	status = process_gas_sensor(zse);
-	if (status != GOLIOTH_OK)
-	{
-		return status;
+	for (int group = 0; group < APP_SENSORS_GROUP_COUNT; group++) {
+		if (!encode_group(zse, group, sample, format)) {
+			return -ENOMEM;
+		}
 	}
 
-	ok = zcbor_map_end_encode(zse, 4);
+	ok = zcbor_map_end_encode(zse, APP_SENSORS_GROUP_COUNT);
 	if (!ok)
 	{
-		LOG_ERR("ZCBOR failed to close weather map");
-		return GOLIOTH_ERR_QUEUE_FULL;
+		LOG_ERR("ZCBOR failed to close map");
+		return -ENOMEM;
+	}
+
+	return zse->payload - buf;
+}
+
+/* Stream a single sample, or queue it in flash if it cannot be sent now */
+static void stream_or_queue_sample(int64_t uptime_ms, const uint8_t *buf, size_t len)
+{
+	int err;
+	bool connected = client_connected();
+
+	if (connected) {
+		/* Send to LightDB Stream on "sensor" endpoint */
+		err = golioth_stream_set_async(client, "sensor", GOLIOTH_CONTENT_TYPE_CBOR, buf,
+					       len, async_error_handler, NULL);
+		if (err) {
+			LOG_ERR("Failed to send sensor data to Golioth: %d", err);
+		}
+		count_stream_result(err);
+
+		/* Queued samples carry their own timestamps, so they can follow this one */
+		app_sample_queue_drain(client);
+		return;
+	}
+
+	err = app_sample_queue_push(uptime_ms, APP_BATCH_FORMAT_STANDARD, buf, len);
+	count_queue_result(err);
+	if (err == -ENOTSUP) {
+		LOG_DBG("No connection available, skipping sending data to Golioth");
+	}
+}
+
+/* Encode a sample into a buffer of its own and stream or queue it */
+static int stream_sample(int64_t uptime_ms, const struct sensors_sample *sample)
+{
+	struct net_buf *buf = app_uplink_buf_alloc(SAMPLE_MAX_LEN);
+	int len;
+
+	if (!buf) {
+		atomic_inc(&uplink_dropped);
+		return -ENOMEM;
+	}
+
+	len = encode_sample(sample, APP_BATCH_FORMAT_STANDARD, net_buf_tail(buf),
+			    net_buf_tailroom(buf));
+	if (len >= 0) {
+		net_buf_add(buf, len);
+		TIMING_MARK(encoded);
+		stream_or_queue_sample(uptime_ms, buf->data, buf->len);
+	}
+
+	/* Stream requests and the flash queue both keep their own copy */
+	net_buf_unref(buf);
+
+	return len;
+}
+
+/* Send the first @p count batched samples as one request, or move them to the flash queue */
+static void send_batch(uint8_t count)
+{
+	uint8_t *data = batch_buf->data;
+	int64_t now_ms = k_uptime_get();
+	size_t len = 0;
+	int err;
+
+	if (batch_split) {
+		/* Batching is off, so held samples keep the wire format of a direct send */
+		for (int i = 0; i < count; i++) {
+			stream_or_queue_sample(batch_start_ms + batch_samples[i].offset_ms,
+					       &data[batch_samples[i].pos], batch_samples[i].len);
+		}
+		return;
+	}
+
+	if (!client_connected()) {
+		for (int i = 0; i < count; i++) {
+			err = app_sample_queue_push(batch_start_ms + batch_samples[i].offset_ms,
+						    batch_format, &data[batch_samples[i].pos],
+						    batch_samples[i].len);
+			if (err == -ENOTSUP) {
+				LOG_DBG("No connection available, skipping sending data");
+				atomic_add(&uplink_dropped, count - i);
+				break;
+			}
+			count_queue_result(err);
+		}
+
+		if (client_connected()) {
+			app_sample_queue_drain(client);
+		}
+		return;
+	}
+
+	for (int i = 0; i < count; i++) {
+		const struct batch_sample *entry = &batch_samples[i];
+
+		/* Offsets kept on device are resolved to the absolute time the pipeline expects,
+		 * or to the sample's age if the time of day is not known yet
+		 */
+		int64_t uptime_ms = batch_start_ms + entry->offset_ms;
+		int64_t unix_ms = app_batch_uptime_to_unix_ms(uptime_ms);
+
+		/* Every sample had a full size gap in front of it, so the entries written so far
+		 * never reach past the start of this one.
+		 */
+		int hdr_len = app_batch_put_entry_hdr(&data[len], entry->pos - len, unix_ms,
+						      now_ms - uptime_ms);
+
+		if (hdr_len < 0) {
+			LOG_ERR("Failed to encode batch entry: %d", hdr_len);
+			return;
+		}
+
+		len += hdr_len;
+		if (len != entry->pos) {
+			memmove(&data[len], &data[entry->pos], entry->len);
+		}
+		len += entry->len;
+	}
+
+	app_batch_put_array_hdr(net_buf_push(batch_buf, APP_BATCH_ARRAY_HDR_LEN), count);
+	len += APP_BATCH_ARRAY_HDR_LEN;
+
+	LOG_DBG("Streaming batch of %u samples (%zu bytes)", count, len);
+
+	err = golioth_stream_set_async(client, app_batch_stream_path(batch_format),
+				       GOLIOTH_CONTENT_TYPE_CBOR, batch_buf->data, len,
+				       async_error_handler, NULL);
+	if (err) {
+		LOG_ERR("Failed to send sensor batch to Golioth: %d", err);
+	}
+	count_stream_result(err);
+
+	app_sample_queue_drain(client);
+}
+
+static void batch_age_work_handler(struct k_work *work)
+{
+	/* The batch belongs to the main thread; let it decide whether to send */
+	atomic_set(&batch_age_expired, 1);
+	wake_system_thread();
+}
+
+static K_WORK_DELAYABLE_DEFINE(batch_age_work, batch_age_work_handler);
+
+/* Wake the main thread when the open batch reaches its age limit, even if no sample follows */
+static void arm_batch_age(void)
+{
+	if (batch_max_age_ms > 0) {
+		k_work_reschedule(&batch_age_work,
+				  K_TIMEOUT_ABS_MS(batch_start_ms + batch_max_age_ms));
+	}
+}
+
+static void release_batch(void)
+{
+	k_work_cancel_delayable(&batch_age_work);
+
+	if (batch_buf) {
+		net_buf_unref(batch_buf);
+		batch_buf = NULL;
+	}
+
+	batch_count = 0;
+	batch_used = 0;
+}
+
+/* Send all samples held in RAM and give the buffer back to the pool */
+static void flush_batch(void)
+{
+	if (batch_count > 0) {
+		send_batch(batch_count);
+	}
+
+	release_batch();
+}
+
+/* Send all but the newest sample and keep that one as the start of a new batch */
+static void roll_over_batch(int64_t uptime_ms)
+{
+	struct batch_sample last = batch_samples[batch_count - 1];
+	const uint8_t *src = &batch_buf->data[last.pos];
+
+	send_batch(batch_count - 1);
+
+	net_buf_reset(batch_buf);
+	net_buf_reserve(batch_buf, APP_BATCH_ARRAY_HDR_LEN);
+	net_buf_add(batch_buf, APP_BATCH_ENTRY_HDR_MAX_LEN);
+	memmove(net_buf_tail(batch_buf), src, last.len);
+	net_buf_add(batch_buf, last.len);
+
+	batch_samples[0].offset_ms = 0;
+	batch_samples[0].pos = APP_BATCH_ENTRY_HDR_MAX_LEN;
+	batch_samples[0].len = last.len;
+	batch_count = 1;
+	batch_used = last.len;
+	batch_start_ms = uptime_ms;
+}
+
+/*
+ * Encode a sample into the open batch, opening one if needed; returns its size or an error.
+ * While @p hold is set the batch is only sent once it is full.
+ */
+static int add_to_batch(const struct app_config *cfg, int64_t uptime_ms,
+			enum app_batch_format format, const struct sensors_sample *sample,
+			bool hold)
+{
+	size_t max_bytes = MIN((size_t) cfg->batch_max_bytes, CONFIG_APP_SENSORS_BATCH_BUF_SIZE);
+	int64_t max_age_ms = (int64_t) cfg->batch_max_age_s * MSEC_PER_SEC;
+	struct batch_sample *entry;
+	int len;
+
+	if ((batch_count > 0) && (format != batch_format)) {
+		flush_batch();
+	}
+
+	if (batch_count == 0) {
+		batch_buf = app_uplink_buf_alloc(BATCH_ALLOC_LEN);
+		if (!batch_buf) {
+			atomic_inc(&uplink_dropped);
+			return -ENOMEM;
+		}
+
+		net_buf_reserve(batch_buf, APP_BATCH_ARRAY_HDR_LEN);
+		batch_start_ms = uptime_ms;
+		batch_format = format;
+		batch_split = (format == APP_BATCH_FORMAT_STANDARD) &&
+			      (cfg->batch_max_samples <= 1);
+		batch_max_age_ms = max_age_ms;
+		arm_batch_age();
+	}
+
+	net_buf_add(batch_buf, APP_BATCH_ENTRY_HDR_MAX_LEN);
+
+	len = encode_sample(sample, format, net_buf_tail(batch_buf), net_buf_tailroom(batch_buf));
+	if (len < 0) {
+		if (batch_count == 0) {
+			release_batch();
+		} else {
+			net_buf_remove_mem(batch_buf, APP_BATCH_ENTRY_HDR_MAX_LEN);
+		}
+		return len;
+	}
+
+	TIMING_MARK(encoded);
+
+	entry = &batch_samples[batch_count];
+	entry->offset_ms = uptime_ms - batch_start_ms;
+	entry->pos = batch_buf->len;
+	entry->len = len;
+	net_buf_add(batch_buf, len);
+	batch_used += len;
+	batch_count++;
+
+	if ((batch_count > 1) && (batch_used > max_bytes)) {
+		roll_over_batch(uptime_ms);
+		arm_batch_age();
 	}
 
-	return GOLIOTH_OK;
+	if (batch_used > max_bytes) {
+		/* Too large to ever batch */
+		if (format == APP_BATCH_FORMAT_COMPACT) {
+			LOG_ERR("Compact sample of %d bytes exceeds batch size", len);
+		} else {
+			stream_or_queue_sample(uptime_ms,
+					       &batch_buf->data[batch_samples[0].pos], len);
+		}
+
+		release_batch();
+		return len;
+	}
+
+	LOG_DBG("Batched sample %u (%zu/%zu bytes)", batch_count, batch_used, max_bytes);
+
+	if ((batch_count >= CONFIG_APP_SENSORS_BATCH_MAX_SAMPLES) || (batch_used >= max_bytes)) {
+		flush_batch();
+	} else if (!hold &&
+		   ((batch_count >= cfg->batch_max_samples) ||
+		    ((max_age_ms > 0) && ((uptime_ms - batch_start_ms) >= max_age_ms)))) {
+		flush_batch();
+	}
+
+	return len;
+}
+
+static const int32_t pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+/* A reading in steps of 10^-decimals of its unit, the integer the aggregates work on */
+static int32_t to_window_units(const struct sensor_value *val, uint8_t decimals)
+{
+	return (val->val1 * pow10[decimals]) + (val->val2 / pow10[6 - decimals]);
+}
+
+static bool put_summary_value(zcbor_state_t *zse, int64_t micro)
+{
+	union float_bits bits = {.f32 = app_fixed_micro_to_f32(micro)};
+
+	return zcbor_float32_encode(zse, &bits.f);
 }
 
-static enum golioth_status read_accel_sensor(zcbor_state_t *zse)
+/* <key>: [min, max, mean, variance, count], in the channel's unit (squared for variance) */
+static bool encode_channel_summary(zcbor_state_t *zse, const struct channel_desc *desc,
+				   const struct app_aggregate *agg, enum app_batch_format format)
 {
-	struct sensor_value accel_x;
-	struct sensor_value accel_y;
-	struct sensor_value accel_z;
+	const int64_t scale = pow10[6 - desc->decimals];
+	const int64_t var_scale = pow10[6 - (2 * desc->decimals)];
+	const int frac_bits = 2 * APP_AGGREGATE_MEAN_FRAC_BITS;
+	uint64_t var_q = app_aggregate_variance_q(agg);
+	uint64_t var_whole = MIN(var_q >> frac_bits, (uint64_t) (INT64_MAX / var_scale) - 1);
+	uint64_t var_frac = var_q & BIT64_MASK(frac_bits);
+	int64_t var_micro = (var_whole * var_scale) + ((var_frac * var_scale) >> frac_bits);
 	bool ok;
 
-	/* ADXL362 */
-	int err = sensor_sample_fetch(accel);
+	if (format == APP_BATCH_FORMAT_STANDARD) {
+		ok = zcbor_tstr_put_term(zse, desc->key, SIZE_MAX);
+	} else {
+		ok = zcbor_uint32_put(zse, desc->compact_key);
+	}
+
+	if (agg->n == 0) {
+		/* Only written in the compact format, which lists every channel */
+		return ok && zcbor_nil_put(zse, NULL);
+	}
+
+	return ok && zcbor_list_start_encode(zse, 5) &&
+	       put_summary_value(zse, agg->min * scale) &&
+	       put_summary_value(zse, agg->max * scale) &&
+	       put_summary_value(zse, (agg->mean_q * scale) >> APP_AGGREGATE_MEAN_FRAC_BITS) &&
+	       put_summary_value(zse, var_micro) && zcbor_uint32_put(zse, agg->n) &&
+	       zcbor_list_end_encode(zse, 5);
+}
+
+/// Encode the open window as a CBOR map of its length in seconds under "w" and one map of
+/// channel summaries per sensor group
+///
+/// The compact format uses the integer keys of the compact sample encoding, with 0 for "w",
+/// and like compact samples lists every group and channel, nil for those without readings.
+///
+/// @retval Number of bytes written to buf or -ENOMEM
+static int encode_summary(uint32_t window_s, enum app_batch_format format, uint8_t *buf,
+			  size_t buf_len)
+{
+	bool all = (format == APP_BATCH_FORMAT_COMPACT);
+	bool ok;
+
+	ZCBOR_STATE_E(zse, 3, buf, buf_len, 1);
+
+	ok = zcbor_map_start_encode(zse, APP_SENSORS_GROUP_COUNT + 1);
+	if (all) {
+		ok = ok && zcbor_uint32_put(zse, 0);
+	} else {
+		ok = ok && zcbor_tstr_put_lit(zse, "w");
+	}
+	ok = ok && zcbor_uint32_put(zse, window_s);
+
+	for (int group = 0; ok && (group < APP_SENSORS_GROUP_COUNT); group++) {
+		size_t count = 0;
+
+		for (int ch = 0; ch < CH_COUNT; ch++) {
+			if ((channels[ch].group == group) && (all || (window_stats[ch].n > 0))) {
+				count++;
+			}
+		}
+
+		if (count == 0) {
+			continue;
+		}
+
+		if (all) {
+			ok = zcbor_uint32_put(zse, groups[group].compact_key);
+		} else {
+			ok = zcbor_tstr_put_term(zse, groups[group].key, SIZE_MAX);
+		}
+		ok = ok && zcbor_map_start_encode(zse, count);
+
+		for (int ch = 0; ok && (ch < CH_COUNT); ch++) {
+			if ((channels[ch].group == group) && (all || (window_stats[ch].n > 0))) {
+				ok = encode_channel_summary(zse, &channels[ch], &window_stats[ch],
+							    format);
+			}
+		}
+
+		ok = ok && zcbor_map_end_encode(zse, count);
+	}
+
+	if (!ok || !zcbor_map_end_encode(zse, APP_SENSORS_GROUP_COUNT + 1)) {
+		LOG_ERR("ZCBOR failed to encode window summary");
+		return -ENOMEM;
+	}
+
+	return zse->payload - buf;
+}
+
+/* Stream the summary of the open window to the "summary" or "summary_compact" path and close
+ * the window
+ */
+static int send_summary(int64_t uptime_ms, enum app_batch_format format)
+{
+	uint32_t window_s = (uint32_t) ((uptime_ms - window_start_ms) / MSEC_PER_SEC);
+	struct net_buf *buf;
+	int len;
+	int err;
+
+	window_open = false;
+
+	buf = app_uplink_buf_alloc(SUMMARY_MAX_LEN);
+	if (!buf) {
+		atomic_inc(&uplink_dropped);
+		return -ENOMEM;
+	}
+
+	len = encode_summary(window_s, format, net_buf_tail(buf), net_buf_tailroom(buf));
+	if (len < 0) {
+		net_buf_unref(buf);
+		return len;
+	}
+
+	net_buf_add(buf, len);
+	TIMING_MARK(encoded);
+
+	if (!client_connected()) {
+		/* Replayed to the same path once the client connects */
+		err = app_sample_queue_push_summary(uptime_ms, format, buf->data, buf->len);
+		count_queue_result(err);
+		if (err == -ENOTSUP) {
+			LOG_DBG("No connection available, dropping window summary");
+		}
+
+		net_buf_unref(buf);
+
+		return err ? err : len;
+	}
+
+	err = golioth_stream_set_async(client, app_batch_summary_path(format),
+				       GOLIOTH_CONTENT_TYPE_CBOR, buf->data, buf->len,
+				       async_error_handler, NULL);
 	if (err) {
-		LOG_ERR("Error fetching ADXL362 sensor sample: %d", err);
-		return GOLIOTH_ERR_FAIL;
+		LOG_ERR("Failed to send window summary to Golioth: %d", err);
 	}
-	sensor_channel_get(accel, SENSOR_CHAN_ACCEL_X, &accel_x);
-	sensor_channel_get(accel, SENSOR_CHAN_ACCEL_Y, &accel_y);
-	sensor_channel_get(accel, SENSOR_CHAN_ACCEL_Z, &accel_z);
-	LOG_DBG("X: %d.%06d; Y: %d.%06d; Z: %d.%06d", accel_x.val1, abs(accel_x.val2), accel_y.val1,
-		abs(accel_y.val2), accel_z.val1, abs(accel_z.val2));
+	count_stream_result(err);
 
-	ok = zcbor_tstr_put_lit(zse, "accel") && zcbor_map_start_encode(zse, 3);
-	if (!ok)
-	{
-		LOG_ERR("ZCBOR unable to open accel map");
-		return GOLIOTH_ERR_QUEUE_FULL;
+	net_buf_unref(buf);
+
+	/* Queued summaries and samples can follow this one */
+	app_sample_queue_drain(client);
+
+	return err ? err : len;
+}
+
+/*
+ * Fold a reading into the open window, first sending the previous window's summary if this
+ * reading falls past its end. Nothing goes out otherwise.
+ *
+ * @retval Size of the summary sent, 0 if none was due, or a negative error
+ */
+static int aggregate_sample(const struct app_config *cfg, int64_t uptime_ms,
+			    const struct sensors_sample *sample)
+{
+	enum app_batch_format format = cfg->compact_encoding ? APP_BATCH_FORMAT_COMPACT :
+							       APP_BATCH_FORMAT_STANDARD;
+	int ret = 0;
+
+	if (window_open &&
+	    ((uptime_ms - window_start_ms) >= ((int64_t) cfg->aggregate_window_s * MSEC_PER_SEC))) {
+		ret = send_summary(uptime_ms, format);
 	}
 
-	ok = zcbor_tstr_put_lit(zse, "x") &&
-	     zcbor_float64_put(zse, sensor_value_to_double(&accel_x)) &&
-	     zcbor_tstr_put_lit(zse, "y") &&
-	     zcbor_float64_put(zse, sensor_value_to_double(&accel_y)) &&
-	     zcbor_tstr_put_lit(zse, "z") &&
-	     zcbor_float64_put(zse, sensor_value_to_double(&accel_z));
-	if (!ok)
-	{
-		LOG_ERR("ZCBOR failed to encode accel data");
-		return GOLIOTH_ERR_QUEUE_FULL;
+	if (!window_open) {
+		for (int ch = 0; ch < CH_COUNT; ch++) {
+			app_aggregate_reset(&window_stats[ch]);
+		}
+
+		window_start_ms = uptime_ms;
+		window_open = true;
 	}
 
-	ok = zcbor_map_end_encode(zse, 3);
-	if (!ok)
-	{
-		LOG_ERR("ZCBOR failed to close accel map");
-		return GOLIOTH_ERR_QUEUE_FULL;
+	for (int ch = 0; ch < CH_COUNT; ch++) {
+		if (!sample->valid[ch]) {
+			continue;
+		}
+
+		int32_t value = to_window_units(&sample->values[ch], channels[ch].decimals);
+
+		app_aggregate_add(&window_stats[ch], value);
 	}
 
-	return GOLIOTH_OK;
+	return ret;
 }
 
 /* This will be called by the main() loop after delays or on button presses */
 /* Do all of your work here! */
-void app_sensors_read_and_stream(void)
+void app_sensors_read_and_stream(uint32_t groups)
 {
-	int err;
-	bool ok;
-	enum golioth_status status;
-	char cbor_buf[256];
+	struct sensors_sample sample = {0};
+	struct app_config cfg;
+	int64_t sample_uptime_ms = k_uptime_get();
+	int cbor_size;
 
-	ZCBOR_STATE_E(zse, 3, cbor_buf, sizeof(cbor_buf), 1);
+	IF_ENABLED(CONFIG_APP_SENSORS_BENCHMARK, (timing.len = 0;));
+	TIMING_MARK(start);
 
-	ok = zcbor_map_start_encode(zse, 3);
+	/* One view of the settings for the whole cycle, even if they change part way through */
+	app_settings_snapshot(&cfg);
 
-	if (!ok)
-	{
-		LOG_ERR("ZCBOR failed to open map");
+	enum app_batch_format format = cfg.compact_encoding ? APP_BATCH_FORMAT_COMPACT :
+							      APP_BATCH_FORMAT_STANDARD;
+
+	fetch_sensors(groups, &sample);
+	TIMING_MARK(fetched);
+
+	if (IS_ENABLED(CONFIG_APP_VIBRATION) && cfg.vibration_mode &&
+	    (groups & BIT(APP_SENSORS_ACCEL))) {
+		app_vibration_capture_and_stream(client, accel);
+	}
+
+	if (cfg.aggregate_window_s > 0) {
+		/* Anything batched before aggregation was turned on goes out first */
+		flush_batch();
+
+		cbor_size = aggregate_sample(&cfg, sample_uptime_ms, &sample);
+		if (cbor_size > 0) {
+			TIMING_MARK(enqueued);
+			LOG_DBG("Sent window summary: %d bytes", cbor_size);
+		}
 		return;
 	}
 
-	status = read_light_sensor(zse);
-	if (status == GOLIOTH_ERR_QUEUE_FULL)
-	{
+	if (window_open) {
+		/* Aggregation was just turned off; report the part of the window already seen */
+		send_summary(sample_uptime_ms, format);
+	}
+
+	if (apply_deadband(&cfg, &sample) == 0) {
+		LOG_DBG("No channel moved past its deadband, nothing to send");
 		return;
 	}
 
-	status = read_weather_sensor(zse);
-	if (status == GOLIOTH_ERR_QUEUE_FULL)
-	{
+	/* Samples wait in the batch while the radio is idle, to go out with the next connection */
+	bool hold = app_radio_hold_ms((batch_count > 0) ? batch_start_ms : sample_uptime_ms) > 0;
+
+	/* Compact samples are always framed as a batch so their pipeline can expand them */
+	if ((cfg.batch_max_samples > 1) || (format == APP_BATCH_FORMAT_COMPACT) || hold) {
+		cbor_size = add_to_batch(&cfg, sample_uptime_ms, format, &sample, hold);
+	} else {
+		/* Batching may have just been turned off; send anything still held first */
+		flush_batch();
+		cbor_size = stream_sample(sample_uptime_ms, &sample);
+	}
+
+	if (cbor_size < 0) {
 		return;
 	}
 
-	status = read_accel_sensor(zse);
-	if (status == GOLIOTH_ERR_QUEUE_FULL)
-	{
+	TIMING_MARK(enqueued);
+
+	LOG_DBG("Encoded %s sample: %d bytes",
+		(format == APP_BATCH_FORMAT_COMPACT) ? "compact" : "standard", cbor_size);
+	IF_ENABLED(CONFIG_APP_SENSORS_BENCHMARK, (timing.len = cbor_size;));
+}
+
+void app_sensors_flush(void)
+{
+	flush_batch();
+}
+
+bool app_sensors_batch_due(void)
+{
+	if (!atomic_set(&batch_age_expired, 0) || (batch_count == 0) || (batch_max_age_ms <= 0)) {
+		return false;
+	}
+
+	if ((k_uptime_get() - batch_start_ms) < batch_max_age_ms) {
+		return false;
+	}
+
+	/* A batch held for the radio goes out with the next window instead */
+	return app_radio_hold_ms(batch_start_ms) == 0;
+}
+
+void app_sensors_set_client(struct golioth_client *sensors_client)
+{
+	client = sensors_client;
+}
+
+#ifdef CONFIG_APP_SENSORS_BENCHMARK
+
+struct phase_stats {
+	uint64_t sum_ns;
+	uint64_t min_ns;
+	uint64_t max_ns;
+};
+
+static void phase_add(struct phase_stats *p, uint32_t from, uint32_t to)
+{
+	uint64_t ns = bench_to_ns(to - from);
+
+	p->sum_ns += ns;
+	p->min_ns = MIN(p->min_ns, ns);
+	p->max_ns = MAX(p->max_ns, ns);
+}
+
+static void phase_log(const char *name, const struct phase_stats *p, uint32_t count)
+{
+	if (count == 0) {
 		return;
 	}
 
-	ok = zcbor_map_end_encode(zse, 3);
-	if (!ok)
-	{
-		LOG_ERR("ZCBOR failed to close map");
+	/* Each measurement fits 32 bits, since the clock it comes from wraps there */
+	LOG_INF("  %-8s avg %u ns, min %u ns, max %u ns", name, (uint32_t) (p->sum_ns / count),
+		(uint32_t) p->min_ns, (uint32_t) p->max_ns);
+}
+
+static void benchmark_format(bool compact)
+{
+	struct phase_stats acquire = {.min_ns = UINT64_MAX};
+	struct phase_stats encode = {.min_ns = UINT64_MAX};
+	struct phase_stats enqueue = {.min_ns = UINT64_MAX};
+	struct app_config cfg;
+	uint64_t bytes = 0;
+	uint32_t sent = 0;
+
+	app_settings_snapshot(&cfg);
+	cfg.compact_encoding = compact;
+	app_settings_restore(&cfg);
+
+	for (int i = 0; i < CONFIG_APP_SENSORS_BENCHMARK_ITERATIONS; i++) {
+		app_sensors_read_and_stream(APP_SENSORS_ALL);
+
+		phase_add(&acquire, timing.start, timing.fetched);
+
+		if (timing.len > 0) {
+			phase_add(&encode, timing.fetched, timing.encoded);
+			phase_add(&enqueue, timing.encoded, timing.enqueued);
+			bytes += timing.len;
+			sent++;
+		}
 	}
 
-	size_t cbor_size = zse->payload - (const uint8_t *) cbor_buf;
+	/* Push out whatever is still batched so the next run starts empty */
+	flush_batch();
 
-	/* Only stream sensor data if connected */
-	if (golioth_client_is_connected(client)) {
-		/* Send to LightDB Stream on "sensor" endpoint */
-		err = golioth_stream_set_async(client, "sensor", GOLIOTH_CONTENT_TYPE_CBOR, cbor_buf,
-					cbor_size, async_error_handler, NULL);
-		if (err) {
-			LOG_ERR("Failed to send sensor data to Golioth: %d", err);
+	LOG_INF("%s encoding: %u of %d cycles sent, %u bytes per sample",
+		compact ? "Compact" : "Standard", sent, CONFIG_APP_SENSORS_BENCHMARK_ITERATIONS,
+		sent ? (uint32_t) (bytes / sent) : 0);
+	phase_log("acquire", &acquire, CONFIG_APP_SENSORS_BENCHMARK_ITERATIONS);
+	phase_log("encode", &encode, sent);
+	phase_log("enqueue", &enqueue, sent);
+}
+
+/* Readings across the ranges of the real channels; volatile so every pass reloads them */
+static volatile struct sensor_value bench_values[] = {
+	{23, 450000}, {-7, -125000}, {101, 325000}, {45, 617187}, {0, 31250},
+	{-9, -806650}, {1234, 0},     {0, -4000},   {98765, 432100},
+};
+
+/* Time converting a reading for the float64 encoding, the old double way and in fixed point */
+static void benchmark_conversion(void)
+{
+	const uint32_t count = CONFIG_APP_SENSORS_BENCHMARK_ITERATIONS * ARRAY_SIZE(bench_values);
+	volatile uint64_t sink;
+	uint32_t double_time;
+	uint32_t fixed_time;
+	uint32_t start;
+	int differ = 0;
+
+	start = bench_stamp();
+	for (int i = 0; i < CONFIG_APP_SENSORS_BENCHMARK_ITERATIONS; i++) {
+		for (size_t j = 0; j < ARRAY_SIZE(bench_values); j++) {
+			struct sensor_value v = {bench_values[j].val1, bench_values[j].val2};
+			union float_bits bits = {.d = sensor_value_to_double(&v)};
+
+			sink = bits.f64;
 		}
-	} else {
-		LOG_DBG("No connection available, skipping sending data to Golioth");
 	}
+	double_time = bench_stamp() - start;
+
+	start = bench_stamp();
+	for (int i = 0; i < CONFIG_APP_SENSORS_BENCHMARK_ITERATIONS; i++) {
+		for (size_t j = 0; j < ARRAY_SIZE(bench_values); j++) {
+			struct sensor_value v = {bench_values[j].val1, bench_values[j].val2};
+
+			sink = app_fixed_micro_to_f64(sensor_value_to_micro(&v));
+		}
+	}
+	fixed_time = bench_stamp() - start;
+
+	/* sensor_value_to_double() rounds twice, so the last bit may differ */
+	for (size_t j = 0; j < ARRAY_SIZE(bench_values); j++) {
+		struct sensor_value v = {bench_values[j].val1, bench_values[j].val2};
+		union float_bits bits = {.d = sensor_value_to_double(&v)};
+
+		differ += (bits.f64 != app_fixed_micro_to_f64(sensor_value_to_micro(&v)));
+	}
+
+	ARG_UNUSED(sink);
+
+	LOG_INF("Float64 conversion of %u readings, %d of %zu test values differ in the last bit",
+		count, differ, ARRAY_SIZE(bench_values));
+	LOG_INF("  double   %u ns per reading", (uint32_t) (bench_to_ns(double_time) / count));
+	LOG_INF("  fixed    %u ns per reading", (uint32_t) (bench_to_ns(fixed_time) / count));
+#ifdef BENCH_COUNTS_CYCLES
+	LOG_INF("  double   %u cycles per reading", double_time / count);
+	LOG_INF("  fixed    %u cycles per reading", fixed_time / count);
+#endif
 }
 
-void app_sensors_set_client(struct golioth_client *sensors_client)
+void app_sensors_benchmark(void)
 {
-	client = sensors_client;
+	struct app_config saved;
+	size_t unused;
+
+	bench_init();
+
+	app_settings_snapshot(&saved);
+
+	benchmark_conversion();
+
+	LOG_INF("Benchmarking %d sensor cycles per encoding",
+		CONFIG_APP_SENSORS_BENCHMARK_ITERATIONS);
+
+	benchmark_format(false);
+	benchmark_format(true);
+
+	app_settings_restore(&saved);
+
+	if (k_thread_stack_space_get(k_current_get(), &unused) == 0) {
+		LOG_INF("Stack high-water mark: %zu of %zu bytes",
+			k_current_get()->stack_info.size - unused,
+			k_current_get()->stack_info.size);
+	}
 }
+
+#endif /* CONFIG_APP_SENSORS_BENCHMARK */
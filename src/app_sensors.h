@@ -7,9 +7,54 @@
 #ifndef __APP_SENSORS_H__
 #define __APP_SENSORS_H__
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <golioth/client.h>
+#include <zephyr/sys/util.h>
+
+/* Sensors that are read, scheduled and encoded together */
+enum app_sensors_group {
+	APP_SENSORS_LIGHT,
+	APP_SENSORS_WEATHER,
+	APP_SENSORS_ACCEL,
+	APP_SENSORS_GROUP_COUNT
+};
+
+/* Groups this board has sensors for */
+#if defined(CONFIG_DT_HAS_ROHM_BH1749_ENABLED)
+#define APP_SENSORS_ALL (BIT(APP_SENSORS_GROUP_COUNT) - 1)
+#else
+#define APP_SENSORS_ALL (BIT(APP_SENSORS_WEATHER) | BIT(APP_SENSORS_ACCEL))
+#endif
+
+struct app_sensors_uplink_stats {
+	uint32_t sent;    /* stream requests acknowledged by Golioth */
+	uint32_t failed;  /* stream requests refused or not acknowledged; their samples are lost */
+	uint32_t queued;  /* samples stored in the offline queue instead */
+	uint32_t dropped; /* samples neither sent nor stored */
+};
 
 void app_sensors_set_client(struct golioth_client *sensors_client);
-void app_sensors_read_and_stream(void);
+void app_sensors_get_uplink_stats(struct app_sensors_uplink_stats *stats);
+
+/* Read the groups in the bitmask (BIT(enum app_sensors_group)) and stream them as one sample */
+void app_sensors_read_and_stream(uint32_t groups);
+
+/* Send any samples held in the batch now; call from the thread that reads the sensors */
+void app_sensors_flush(void);
+
+/* True if the batch has reached BATCH_MAX_AGE_S since the main thread was woken for it; call
+ * from the thread that reads the sensors and send the batch with app_sensors_flush()
+ */
+bool app_sensors_batch_due(void);
+
+/**
+ * Time the acquire, encode and enqueue steps over CONFIG_APP_SENSORS_BENCHMARK_ITERATIONS
+ * cycles in each encoding and log the results
+ *
+ * Meant to run before the Golioth client is set, so samples go to the batch and offline
+ * queue instead of the network.
+ */
+void app_sensors_benchmark(void);
 
 #endif /* __APP_SENSORS_H__ */
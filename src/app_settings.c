@@ -8,22 +8,80 @@
 #include <sys/_stdint.h>
 LOG_MODULE_REGISTER(app_settings, LOG_LEVEL_DBG);
 
+#include <string.h>
 #include <golioth/client.h>
 #include <golioth/settings.h>
 #include <zephyr/drivers/pwm.h>
 #include "main.h"
 
 #include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/barrier.h>
 
+#include "app_motion.h"
+#include "app_persist.h"
 #include "app_settings.h"
 
 int period = 100000; /* should be 100 uSec */
 
-static int32_t _loop_delay_s = 60;
 #define LOOP_DELAY_S_MAX 43200
 #define LOOP_DELAY_S_MIN 1
+
+/* Settings are only registered for sensors this board has */
+static const char *const sensor_period_names[APP_SENSORS_GROUP_COUNT] = {
+#if defined(CONFIG_DT_HAS_ROHM_BH1749_ENABLED)
+	[APP_SENSORS_LIGHT] = "LIGHT_PERIOD_S",
+#endif
+	[APP_SENSORS_WEATHER] = "WEATHER_PERIOD_S",
+	[APP_SENSORS_ACCEL] = "ACCEL_PERIOD_S",
+};
 #define LED_FADE_SPEED_MS_MAX 10000
 #define LED_FADE_SPEED_MS_MIN 500
+#define BATCH_MAX_AGE_S_MAX 86400
+#define BATCH_MAX_BYTES_MIN 128
+#define AGGREGATE_WINDOW_S_MAX 86400
+
+enum BATCH_CB_INDEX {
+	BATCH_SAMPLES_CB_ARG,
+	BATCH_AGE_CB_ARG,
+	BATCH_BYTES_CB_ARG,
+};
+
+#define MOTION_HOLD_S_MAX 86400
+#define MOTION_THRESH_MG_MAX 2047
+
+enum MOTION_CB_INDEX {
+	MOTION_FAST_DELAY_CB_ARG,
+	MOTION_HOLD_CB_ARG,
+	MOTION_ACT_THRESH_CB_ARG,
+	MOTION_INACT_THRESH_CB_ARG,
+};
+
+#define DEADBAND_KEEPALIVE_MAX 1000
+#define DEADBAND_MAX 1000000000.0f
+
+enum DEADBAND_CB_INDEX {
+	DEADBAND_KEEPALIVE_CB_ARG,
+	DEADBAND_REL_PCT_CB_ARG,
+};
+
+/* Settings are only registered for channels this board has */
+static const char *const deadband_names[APP_DEADBAND_COUNT] = {
+#if defined(CONFIG_DT_HAS_ROHM_BH1749_ENABLED)
+	[APP_DEADBAND_LIGHT] = "DEADBAND_LIGHT",
+#endif
+	[APP_DEADBAND_TEM] = "DEADBAND_TEM",
+	[APP_DEADBAND_PRE] = "DEADBAND_PRE",
+	[APP_DEADBAND_HUM] = "DEADBAND_HUM",
+#if defined(CONFIG_APP_SENSORS_THINGY91)
+	[APP_DEADBAND_GAS] = "DEADBAND_GAS",
+#elif defined(CONFIG_APP_SENSORS_THINGY91X)
+	[APP_DEADBAND_IAQ] = "DEADBAND_IAQ",
+	[APP_DEADBAND_CO2] = "DEADBAND_CO2",
+	[APP_DEADBAND_VOC] = "DEADBAND_VOC",
+#endif
+	[APP_DEADBAND_ACCEL] = "DEADBAND_ACCEL",
+};
 
 enum LED_PCT_CB_INDEX {
 	LED_R_CB_ARG,
@@ -31,60 +89,268 @@ enum LED_PCT_CB_INDEX {
 	LED_B_CB_ARG,
 };
 
-static int32_t _red_intensity_pct = 50;
-static int32_t _green_intensity_pct = 50;
-static int32_t _blue_intensity_pct = 50;
+/*
+ * The active copy is config_buf[config_seq & 1]. Settings callbacks change the other copy under
+ * config_write_mutex and publish it by incrementing config_seq. Readers never block: they copy
+ * the active buffer and retry if config_seq moved meanwhile, which can only happen if a writer
+ * published and may have started on the buffer being read.
+ */
+static struct app_config config_buf[2] = {
+	/* The other copy is filled in by config_begin() before it is first published */
+	[0] = {
+		.loop_delay_s = 60,
+		.led_fade_speed_ms = 1200,
+		.red_intensity_pct = 50,
+		.green_intensity_pct = 50,
+		.blue_intensity_pct = 50,
+		/* A batch size of 1 streams every sample as soon as it is taken */
+		.batch_max_samples = 1,
+		.batch_max_age_s = 0,
+		.batch_max_bytes = CONFIG_APP_SENSORS_BATCH_BUF_SIZE,
+		.compact_encoding = IS_ENABLED(CONFIG_APP_SENSORS_COMPACT_ENCODING),
+		/* A window of 0 streams readings themselves rather than summaries of them */
+		.aggregate_window_s = CONFIG_APP_SENSORS_AGGREGATE_WINDOW_S,
+		.motion_fast_delay_s = 10,
+		.motion_hold_s = 120,
+		.motion_act_thresh_mg = 200,
+		.motion_inact_thresh_mg = 100,
+		/* A keep-alive of 1 reports every channel on every cycle, i.e. deadbands are off */
+		.deadband_keepalive = 1,
+		.deadband_rel_pct = 0,
+		/* Absolute deadbands in millionths of the unit, as sensor_value_to_micro() */
+		.deadband_micro = {
+			[APP_DEADBAND_LIGHT] = 10000000,   /* 10 counts */
+			[APP_DEADBAND_TEM] = 200000,       /* 0.2 degC */
+			[APP_DEADBAND_PRE] = 100000,       /* 0.1 kPa */
+			[APP_DEADBAND_HUM] = 1000000,      /* 1 %RH */
+			[APP_DEADBAND_GAS] = 1000000000,   /* 1000 ohm */
+			[APP_DEADBAND_IAQ] = 5000000,      /* 5 index points */
+			[APP_DEADBAND_CO2] = 20000000,     /* 20 ppm */
+			[APP_DEADBAND_VOC] = 500000,       /* 0.5 ppm */
+			[APP_DEADBAND_ACCEL] = 500000,     /* 0.5 m/s^2 */
+		},
+	},
+};
+static atomic_t config_seq;
+K_MUTEX_DEFINE(config_write_mutex);
+
+/* Read one member of the active settings; a 64-bit member cannot tear */
+#define SETTINGS_READ(dst, member)                           \
+	do {                                                 \
+		atomic_val_t seq_;                           \
+                                                             \
+		do {                                         \
+			seq_ = atomic_get(&config_seq);      \
+			(dst) = config_buf[seq_ & 1].member; \
+			barrier_dmem_fence_full();           \
+		} while (atomic_get(&config_seq) != seq_);   \
+	} while (0)
+
+/* Start a change; returns a copy of the current settings to modify */
+static struct app_config *config_begin(void)
+{
+	k_mutex_lock(&config_write_mutex, K_FOREVER);
+
+	atomic_val_t seq = atomic_get(&config_seq);
+	struct app_config *next = &config_buf[(seq + 1) & 1];
+
+	*next = config_buf[seq & 1];
+
+	return next;
+}
+
+/* Make the copy returned by config_begin() the active one */
+static void config_publish(void)
+{
+	barrier_dmem_fence_full();
+	atomic_inc(&config_seq);
+	k_mutex_unlock(&config_write_mutex);
+}
+
+/* Publish the copy returned by config_begin() and save it for the next boot */
+static void config_commit(void)
+{
+	config_publish();
+	app_persist_mark_dirty(APP_PERSIST_SETTINGS);
+}
+
+/* Drop the copy returned by config_begin() */
+static void config_abort(void)
+{
+	k_mutex_unlock(&config_write_mutex);
+}
+
+uint32_t app_settings_snapshot(struct app_config *cfg)
+{
+	atomic_val_t seq;
+
+	do {
+		seq = atomic_get(&config_seq);
+		*cfg = config_buf[seq & 1];
+		barrier_dmem_fence_full();
+	} while (atomic_get(&config_seq) != seq);
+
+	return (uint32_t) seq;
+}
+
+uint32_t app_settings_version(void)
+{
+	return (uint32_t) atomic_get(&config_seq);
+}
 
-static int32_t _led_fade_speed_ms = 1200;
+void app_settings_restore(const struct app_config *saved)
+{
+	struct app_config *cfg = config_begin();
+
+	*cfg = *saved;
+	config_publish();
+}
 
 static const struct pwm_dt_spec pwm_led0 = PWM_DT_SPEC_GET(DT_ALIAS(pwm_led0));
 static const struct pwm_dt_spec pwm_led1 = PWM_DT_SPEC_GET(DT_ALIAS(pwm_led1));
 static const struct pwm_dt_spec pwm_led2 = PWM_DT_SPEC_GET(DT_ALIAS(pwm_led2));
 
 K_SEM_DEFINE(led_pwm_initialized_sem, 0, 1); /* Wait until led pwm is ready */
+K_SEM_DEFINE(led_pwm_wake_sem, 0, 1);        /* Cut the current fade step short */
+K_SEM_DEFINE(led_pwm_off_sem, 0, 1);         /* PWM thread has written zero duty */
 
 #define LED_PWM_STACK 4096
 
-static int led_on_off = 1;
+enum {
+	LED_RED,
+	LED_GREEN,
+	LED_BLUE,
+	LED_COUNT
+};
+
+static const struct pwm_dt_spec *const pwm_leds[LED_COUNT] = {&pwm_led0, &pwm_led1, &pwm_led2};
 
-float intensity_steps[] = {1.00, 0.95, 0.90, 0.85, 0.80, 0.75, 0.70, 0.65, 0.60, 0.55,
-			   0.50, 0.55, 0.60, 0.65, 0.70, 0.75, 0.80, 0.85, 0.90, 0.95};
-int array_size = sizeof(intensity_steps) / sizeof(float);
+static atomic_t led_on_off = ATOMIC_INIT(1);
+static bool led_pwm_running;
+
+/* One cycle of the pulsing effect, in thousandths of the configured intensity */
+static const uint16_t intensity_steps_permille[] = {
+	1000, 950, 900, 850, 800, 750, 700, 650, 600, 550,
+	500, 550, 600, 650, 700, 750, 800, 850, 900, 950,
+};
+
+#define LED_STEPS ARRAY_SIZE(intensity_steps_permille)
+
+/* Pulse width of each LED at each step, rebuilt only when the settings change */
+static uint32_t led_duty_ns[LED_COUNT][LED_STEPS];
 
 void all_leds_on(void)
 {
-	led_on_off = 1;
+	atomic_set(&led_on_off, 1);
+	k_sem_give(&led_pwm_wake_sem);
 }
 
 void all_leds_off(void)
 {
-	led_on_off = 0;
+	atomic_set(&led_on_off, 0);
+}
+
+int all_leds_off_sync(k_timeout_t timeout)
+{
+	uint32_t start = k_cycle_get_32();
+
+	all_leds_off();
+
+	/* Nothing has been written to the LEDs yet */
+	if (!led_pwm_running) {
+		return 0;
+	}
+
+	k_sem_reset(&led_pwm_off_sem);
+	k_sem_give(&led_pwm_wake_sem);
+
+	int err = k_sem_take(&led_pwm_off_sem, timeout);
+
+	if (err) {
+		return err;
+	}
+
+	LOG_DBG("LEDs off after %u us", k_cyc_to_us_floor32(k_cycle_get_32() - start));
+
+	return 0;
+}
+
+/// Compute the pulse widths for every step of the effect
+///
+/// @retval true All LEDs are at zero intensity, so the output never changes
+static bool build_led_duty_table(const struct app_config *cfg)
+{
+	const int32_t pct[LED_COUNT] = {
+		[LED_RED] = cfg->red_intensity_pct,
+		[LED_GREEN] = cfg->green_intensity_pct,
+		[LED_BLUE] = cfg->blue_intensity_pct,
+	};
+	bool dark = true;
+
+	for (int led = 0; led < LED_COUNT; led++) {
+		for (int step = 0; step < LED_STEPS; step++) {
+			led_duty_ns[led][step] = (uint32_t) (((uint64_t) period * pct[led] *
+							      intensity_steps_permille[step]) /
+							     (100 * 1000));
+		}
+
+		dark = dark && (pct[led] == 0);
+	}
+
+	return dark;
 }
 
 extern void led_pwm_thread(void *d0, void *d1, void *d2)
 {
+	uint32_t written_ns[LED_COUNT];
+	struct app_config cfg;
+	uint32_t cfg_version;
+	bool dark;
+	int step = 0;
+
 	/* Block until led pwm is ready */
 	k_sem_take(&led_pwm_initialized_sem, K_FOREVER);
+	led_pwm_running = true;
+
+	cfg_version = app_settings_snapshot(&cfg);
+	dark = build_led_duty_table(&cfg);
+
+	/* Nothing can match this, so the first pass writes every output */
+	memset(written_ns, 0xff, sizeof(written_ns));
+
 	while (1) {
-		int ret = 0;
-		float pulse_ns = 0;
-
-		for (int i = 0; i < array_size; i++) {
-			pulse_ns = (((float)period * (float)_red_intensity_pct *
-				     intensity_steps[i] * (float)led_on_off) /
-				    100);
-			ret = pwm_set_dt(&pwm_led0, period, (int)pulse_ns);
-			pulse_ns = (((float)period * (float)_green_intensity_pct *
-				     intensity_steps[i] * (float)led_on_off) /
-				    100);
-			ret = pwm_set_dt(&pwm_led1, period, (int)pulse_ns);
-			pulse_ns = (((float)period * (float)_blue_intensity_pct *
-				     intensity_steps[i] * (float)led_on_off) /
-				    100);
-			ret = pwm_set_dt(&pwm_led2, period, (int)pulse_ns);
-			/* Sleep thread until next increment of pulsing effect */
-			k_sleep(K_MSEC(_led_fade_speed_ms / array_size));
+		/* Sample once so all three outputs agree with the acknowledgment below */
+		bool on = atomic_get(&led_on_off);
+
+		if (app_settings_version() != cfg_version) {
+			cfg_version = app_settings_snapshot(&cfg);
+			dark = build_led_duty_table(&cfg);
+		}
+
+		for (int led = 0; led < LED_COUNT; led++) {
+			uint32_t pulse_ns = on ? led_duty_ns[led][step] : 0;
+
+			if (pulse_ns != written_ns[led]) {
+				pwm_set_dt(pwm_leds[led], period, pulse_ns);
+				written_ns[led] = pulse_ns;
+			}
+		}
+
+		if (!on) {
+			k_sem_give(&led_pwm_off_sem);
 		}
+
+		if (!on || dark) {
+			/* Static output: sleep until all_leds_on() or an LED setting changes */
+			k_sem_take(&led_pwm_wake_sem, K_FOREVER);
+			continue;
+		}
+
+		/* Sleep thread until next increment of pulsing effect, or until
+		 * all_leds_off_sync() needs the outputs at zero now.
+		 */
+		k_sem_take(&led_pwm_wake_sem, K_MSEC(cfg.led_fade_speed_ms / LED_STEPS));
+		step = (step + 1) % LED_STEPS;
 	}
 }
 
@@ -100,68 +366,361 @@ K_THREAD_DEFINE(led_pwm_tid, LED_PWM_STACK, led_pwm_thread, NULL, NULL, NULL,
 
 int32_t get_loop_delay_s(void)
 {
-	return _loop_delay_s;
+	int32_t value;
+
+	SETTINGS_READ(value, loop_delay_s);
+	return value;
 }
 
 static enum golioth_settings_status on_loop_delay_setting(int32_t new_value, void *arg)
 {
+	struct app_config *cfg = config_begin();
+
 	/* Only update if value has changed */
-	if (_loop_delay_s == new_value) {
+	if (cfg->loop_delay_s == new_value) {
+		config_abort();
 		LOG_DBG("Received LOOP_DELAY_S already matches local value.");
 	} else {
-		_loop_delay_s = new_value;
-		LOG_INF("Set loop delay to %i seconds", _loop_delay_s);
+		cfg->loop_delay_s = new_value;
+		config_commit();
+		LOG_INF("Set loop delay to %i seconds", new_value);
 
 		wake_system_thread();
 	}
 	return GOLIOTH_SETTINGS_SUCCESS;
 }
 
+int32_t get_sensor_period_s(enum app_sensors_group group)
+{
+	int32_t value;
+
+	SETTINGS_READ(value, sensor_period_s[group]);
+	return value;
+}
+
+static enum golioth_settings_status on_sensor_period_setting(int32_t new_value, void *arg)
+{
+	int group = (int) arg;
+
+	if ((group < 0) || (group >= APP_SENSORS_GROUP_COUNT) || !sensor_period_names[group]) {
+		LOG_ERR("Unexpected sensor period index value: %i", group);
+		return GOLIOTH_SETTINGS_VALUE_FORMAT_NOT_VALID;
+	}
+
+	struct app_config *cfg = config_begin();
+
+	/* Only update if value has changed */
+	if (cfg->sensor_period_s[group] == new_value) {
+		config_abort();
+		LOG_DBG("Received %s already matches local value.", sensor_period_names[group]);
+	} else {
+		cfg->sensor_period_s[group] = new_value;
+		config_commit();
+		LOG_INF("Set %s to %d seconds", sensor_period_names[group], new_value);
+
+		wake_system_thread();
+	}
+
+	return GOLIOTH_SETTINGS_SUCCESS;
+}
+
+static enum golioth_settings_status on_compact_encoding_setting(bool new_value, void *arg)
+{
+	struct app_config *cfg = config_begin();
+
+	/* Only update if value has changed */
+	if (cfg->compact_encoding == new_value) {
+		config_abort();
+		LOG_DBG("Received COMPACT_ENCODING already matches local value.");
+	} else {
+		cfg->compact_encoding = new_value;
+		config_commit();
+		LOG_INF("Set sensor encoding to %s", new_value ? "compact" : "standard");
+	}
+
+	return GOLIOTH_SETTINGS_SUCCESS;
+}
+
+static enum golioth_settings_status on_vibration_mode_setting(bool new_value, void *arg)
+{
+	struct app_config *cfg = config_begin();
+
+	/* Only update if value has changed */
+	if (cfg->vibration_mode == new_value) {
+		config_abort();
+		LOG_DBG("Received VIBRATION_MODE already matches local value.");
+	} else {
+		cfg->vibration_mode = new_value;
+		config_commit();
+		LOG_INF("Vibration capture %s", new_value ? "enabled" : "disabled");
+	}
+
+	return GOLIOTH_SETTINGS_SUCCESS;
+}
+
+int32_t get_motion_fast_delay_s(void)
+{
+	int32_t value;
+
+	SETTINGS_READ(value, motion_fast_delay_s);
+	return value;
+}
+
+int32_t get_motion_hold_s(void)
+{
+	int32_t value;
+
+	SETTINGS_READ(value, motion_hold_s);
+	return value;
+}
+
+int32_t get_motion_act_thresh_mg(void)
+{
+	int32_t value;
+
+	SETTINGS_READ(value, motion_act_thresh_mg);
+	return value;
+}
+
+int32_t get_motion_inact_thresh_mg(void)
+{
+	int32_t value;
+
+	SETTINGS_READ(value, motion_inact_thresh_mg);
+	return value;
+}
+
+#ifdef CONFIG_APP_MOTION_TRIGGER
+static enum golioth_settings_status on_motion_setting(int32_t new_value, void *arg)
+{
+	struct app_config *cfg = config_begin();
+	int32_t *global_motion_setting;
+	const char *setting_name;
+
+	switch ((int) arg) {
+		case MOTION_FAST_DELAY_CB_ARG:
+			global_motion_setting = &cfg->motion_fast_delay_s;
+			setting_name = "MOTION_FAST_DELAY_S";
+			break;
+		case MOTION_HOLD_CB_ARG:
+			global_motion_setting = &cfg->motion_hold_s;
+			setting_name = "MOTION_HOLD_S";
+			break;
+		case MOTION_ACT_THRESH_CB_ARG:
+			global_motion_setting = &cfg->motion_act_thresh_mg;
+			setting_name = "MOTION_ACT_THRESH_MG";
+			break;
+		case MOTION_INACT_THRESH_CB_ARG:
+			global_motion_setting = &cfg->motion_inact_thresh_mg;
+			setting_name = "MOTION_INACT_THRESH_MG";
+			break;
+		default:
+			config_abort();
+			LOG_ERR("Unexpected motion setting index value: %i", (int) arg);
+			return GOLIOTH_SETTINGS_VALUE_FORMAT_NOT_VALID;
+	}
+
+	/* Only update if value has changed */
+	if (*global_motion_setting == new_value) {
+		config_abort();
+		LOG_DBG("Received %s already matches local value.", setting_name);
+		return GOLIOTH_SETTINGS_SUCCESS;
+	}
+
+	*global_motion_setting = new_value;
+	config_commit();
+	LOG_INF("Set %s to %d", setting_name, new_value);
+
+	if (((int) arg == MOTION_ACT_THRESH_CB_ARG) || ((int) arg == MOTION_INACT_THRESH_CB_ARG)) {
+		if (app_motion_apply_thresholds()) {
+			return GOLIOTH_SETTINGS_GENERAL_ERROR;
+		}
+	} else {
+		/* A shorter cadence should take effect now, not after the current delay */
+		wake_system_thread();
+	}
+
+	return GOLIOTH_SETTINGS_SUCCESS;
+}
+#endif /* CONFIG_APP_MOTION_TRIGGER */
+
+static enum golioth_settings_status on_deadband_setting(float new_value, void *arg)
+{
+	int index = (int) arg;
+
+	if ((index < 0) || (index >= APP_DEADBAND_COUNT) || !deadband_names[index]) {
+		LOG_ERR("Unexpected deadband index value: %i", index);
+		return GOLIOTH_SETTINGS_VALUE_FORMAT_NOT_VALID;
+	}
+
+	/* Written this way round so NaN is rejected too */
+	if (!((new_value >= 0.0f) && (new_value <= DEADBAND_MAX))) {
+		return GOLIOTH_SETTINGS_VALUE_OUTSIDE_RANGE;
+	}
+
+	int64_t new_micro = (int64_t) ((double) new_value * 1000000.0);
+	struct app_config *cfg = config_begin();
+
+	/* Only update if value has changed */
+	if (cfg->deadband_micro[index] == new_micro) {
+		config_abort();
+		LOG_DBG("Received %s already matches local value.", deadband_names[index]);
+	} else {
+		cfg->deadband_micro[index] = new_micro;
+		config_commit();
+		LOG_INF("Set %s to %d.%06d", deadband_names[index], (int) (new_micro / 1000000),
+			(int) (new_micro % 1000000));
+		/* Applied when the next sample is compared */
+	}
+
+	return GOLIOTH_SETTINGS_SUCCESS;
+}
+
+static enum golioth_settings_status on_deadband_int_setting(int32_t new_value, void *arg)
+{
+	struct app_config *cfg = config_begin();
+	int32_t *global_deadband_setting;
+	const char *setting_name;
+
+	switch ((int) arg) {
+		case DEADBAND_KEEPALIVE_CB_ARG:
+			global_deadband_setting = &cfg->deadband_keepalive;
+			setting_name = "DEADBAND_KEEPALIVE";
+			break;
+		case DEADBAND_REL_PCT_CB_ARG:
+			global_deadband_setting = &cfg->deadband_rel_pct;
+			setting_name = "DEADBAND_REL_PCT";
+			break;
+		default:
+			config_abort();
+			LOG_ERR("Unexpected deadband setting index value: %i", (int) arg);
+			return GOLIOTH_SETTINGS_VALUE_FORMAT_NOT_VALID;
+	}
+
+	/* Only update if value has changed */
+	if (*global_deadband_setting == new_value) {
+		config_abort();
+		LOG_DBG("Received %s already matches local value.", setting_name);
+	} else {
+		*global_deadband_setting = new_value;
+		config_commit();
+		LOG_INF("Set %s to %d", setting_name, new_value);
+	}
+
+	return GOLIOTH_SETTINGS_SUCCESS;
+}
+
+static enum golioth_settings_status on_batch_setting(int32_t new_value, void *arg)
+{
+	struct app_config *cfg = config_begin();
+	int32_t *global_batch_setting;
+	const char *setting_name;
+
+	switch ((int) arg) {
+		case BATCH_SAMPLES_CB_ARG:
+			global_batch_setting = &cfg->batch_max_samples;
+			setting_name = "BATCH_MAX_SAMPLES";
+			break;
+		case BATCH_AGE_CB_ARG:
+			global_batch_setting = &cfg->batch_max_age_s;
+			setting_name = "BATCH_MAX_AGE_S";
+			break;
+		case BATCH_BYTES_CB_ARG:
+			global_batch_setting = &cfg->batch_max_bytes;
+			setting_name = "BATCH_MAX_BYTES";
+			break;
+		default:
+			config_abort();
+			LOG_ERR("Unexpected batch setting index value: %i", (int) arg);
+			return GOLIOTH_SETTINGS_VALUE_FORMAT_NOT_VALID;
+	}
+
+	/* Only update if value has changed */
+	if (*global_batch_setting == new_value) {
+		config_abort();
+		LOG_DBG("Received %s already matches local value.", setting_name);
+	} else {
+		*global_batch_setting = new_value;
+		config_commit();
+		LOG_INF("Set %s to %d", setting_name, new_value);
+		/* Thresholds are checked as each sample is added to the batch */
+	}
+
+	return GOLIOTH_SETTINGS_SUCCESS;
+}
+
+static enum golioth_settings_status on_aggregate_window_setting(int32_t new_value, void *arg)
+{
+	struct app_config *cfg = config_begin();
+
+	/* Only update if value has changed */
+	if (cfg->aggregate_window_s == new_value) {
+		config_abort();
+		LOG_DBG("Received AGGREGATE_WINDOW_S already matches local value.");
+	} else {
+		cfg->aggregate_window_s = new_value;
+		config_commit();
+		LOG_INF("Set AGGREGATE_WINDOW_S to %d", new_value);
+		/* The open window is checked against the new length on the next reading */
+	}
+
+	return GOLIOTH_SETTINGS_SUCCESS;
+}
+
 static enum golioth_settings_status on_fade_speed_setting(int32_t new_value, void *arg)
 {
+	struct app_config *cfg = config_begin();
+
 	/* Only update if value has changed */
-	if (_led_fade_speed_ms == new_value) {
+	if (cfg->led_fade_speed_ms == new_value) {
+		config_abort();
 		LOG_DBG("Received LED_FADE_SPEED_MS already matches local value.");
 	}
 
 	else {
-		_led_fade_speed_ms = new_value;
-		LOG_INF("Set LED fade speed to %d milliseconds", _led_fade_speed_ms);
-		/* not waking system thread here, since the LED update thread is looping */
+		cfg->led_fade_speed_ms = new_value;
+		config_commit();
+		LOG_INF("Set LED fade speed to %d milliseconds", new_value);
+		/* not waking system thread here, the LED thread picks it up at its next step */
 	}
 	return GOLIOTH_SETTINGS_SUCCESS;
 }
 
 static enum golioth_settings_status on_led_pct_setting(int32_t new_value, void *arg)
 {
+	struct app_config *cfg = config_begin();
 	int32_t *global_intensity_pct;
 	char color_letter;
 
 	switch ((int) arg) {
 		case LED_R_CB_ARG:
-			global_intensity_pct = &_red_intensity_pct;
+			global_intensity_pct = &cfg->red_intensity_pct;
 			color_letter = 'R';
 			break;
 		case LED_G_CB_ARG:
-			global_intensity_pct = &_green_intensity_pct;
+			global_intensity_pct = &cfg->green_intensity_pct;
 			color_letter = 'G';
 			break;
 		case LED_B_CB_ARG:
-			global_intensity_pct = &_blue_intensity_pct;
+			global_intensity_pct = &cfg->blue_intensity_pct;
 			color_letter = 'B';
 			break;
 		default:
+			config_abort();
 			LOG_ERR("Unexpected LED intensity index value: %i", (int) arg);
 			return GOLIOTH_SETTINGS_VALUE_FORMAT_NOT_VALID;
 	}
 
 	/* Only update if value has changed */
 	if (*global_intensity_pct == new_value) {
+		config_abort();
 		LOG_DBG("Received %c intensity already matches local value.", color_letter);
 	} else {
 		*global_intensity_pct = new_value;
-		LOG_INF("Set %c intensity to %d percent", color_letter, *global_intensity_pct);
-		/* not waking system thread here, since the LED update thread is looping */
+		config_commit();
+		LOG_INF("Set %c intensity to %d percent", color_letter, new_value);
+		/* The LED thread sleeps indefinitely while all intensities are zero */
+		k_sem_give(&led_pwm_wake_sem);
 	}
 
 	return GOLIOTH_SETTINGS_SUCCESS;
@@ -174,7 +733,6 @@ void check_register_settings_error_and_log(int err, const char *settings_str)
 		return;
 	}
 
-
 	LOG_ERR("Failed to register settings callback for %s: %d", settings_str, err);
 }
 
@@ -192,6 +750,21 @@ void app_settings_register(struct golioth_client *client)
 
 	check_register_settings_error_and_log(err, "LOOP_DELAY_S");
 
+	for (int i = 0; i < APP_SENSORS_GROUP_COUNT; i++) {
+		if (!sensor_period_names[i]) {
+			continue;
+		}
+
+		err = golioth_settings_register_int_with_range(settings,
+							       sensor_period_names[i],
+							       0,
+							       LOOP_DELAY_S_MAX,
+							       on_sensor_period_setting,
+							       (void *) i);
+
+		check_register_settings_error_and_log(err, sensor_period_names[i]);
+	}
+
 	err = golioth_settings_register_int_with_range(settings,
 							   "LED_FADE_SPEED_MS",
 							   LED_FADE_SPEED_MS_MIN,
@@ -227,4 +800,125 @@ void app_settings_register(struct golioth_client *client)
 							   (void *) LED_B_CB_ARG);
 
 	check_register_settings_error_and_log(err, "BLUE_INTENSITY_PCT");
+
+	err = golioth_settings_register_int_with_range(settings,
+							   "BATCH_MAX_SAMPLES",
+							   1,
+							   CONFIG_APP_SENSORS_BATCH_MAX_SAMPLES,
+							   on_batch_setting,
+							   (void *) BATCH_SAMPLES_CB_ARG);
+
+	check_register_settings_error_and_log(err, "BATCH_MAX_SAMPLES");
+
+	err = golioth_settings_register_int_with_range(settings,
+							   "BATCH_MAX_AGE_S",
+							   0,
+							   BATCH_MAX_AGE_S_MAX,
+							   on_batch_setting,
+							   (void *) BATCH_AGE_CB_ARG);
+
+	check_register_settings_error_and_log(err, "BATCH_MAX_AGE_S");
+
+	err = golioth_settings_register_int_with_range(settings,
+							   "BATCH_MAX_BYTES",
+							   BATCH_MAX_BYTES_MIN,
+							   CONFIG_APP_SENSORS_BATCH_BUF_SIZE,
+							   on_batch_setting,
+							   (void *) BATCH_BYTES_CB_ARG);
+
+	check_register_settings_error_and_log(err, "BATCH_MAX_BYTES");
+
+	err = golioth_settings_register_bool(settings,
+					     "COMPACT_ENCODING",
+					     on_compact_encoding_setting,
+					     NULL);
+
+	check_register_settings_error_and_log(err, "COMPACT_ENCODING");
+
+	err = golioth_settings_register_int_with_range(settings,
+							   "AGGREGATE_WINDOW_S",
+							   0,
+							   AGGREGATE_WINDOW_S_MAX,
+							   on_aggregate_window_setting,
+							   NULL);
+
+	check_register_settings_error_and_log(err, "AGGREGATE_WINDOW_S");
+
+	err = golioth_settings_register_int_with_range(settings,
+							   "DEADBAND_KEEPALIVE",
+							   1,
+							   DEADBAND_KEEPALIVE_MAX,
+							   on_deadband_int_setting,
+							   (void *) DEADBAND_KEEPALIVE_CB_ARG);
+
+	check_register_settings_error_and_log(err, "DEADBAND_KEEPALIVE");
+
+	err = golioth_settings_register_int_with_range(settings,
+							   "DEADBAND_REL_PCT",
+							   0,
+							   100,
+							   on_deadband_int_setting,
+							   (void *) DEADBAND_REL_PCT_CB_ARG);
+
+	check_register_settings_error_and_log(err, "DEADBAND_REL_PCT");
+
+	for (int i = 0; i < APP_DEADBAND_COUNT; i++) {
+		if (!deadband_names[i]) {
+			continue;
+		}
+
+		err = golioth_settings_register_float(settings,
+						      deadband_names[i],
+						      on_deadband_setting,
+						      (void *) i);
+
+		check_register_settings_error_and_log(err, deadband_names[i]);
+	}
+
+#ifdef CONFIG_APP_MOTION_TRIGGER
+	err = golioth_settings_register_int_with_range(settings,
+							   "MOTION_FAST_DELAY_S",
+							   LOOP_DELAY_S_MIN,
+							   LOOP_DELAY_S_MAX,
+							   on_motion_setting,
+							   (void *) MOTION_FAST_DELAY_CB_ARG);
+
+	check_register_settings_error_and_log(err, "MOTION_FAST_DELAY_S");
+
+	err = golioth_settings_register_int_with_range(settings,
+							   "MOTION_HOLD_S",
+							   0,
+							   MOTION_HOLD_S_MAX,
+							   on_motion_setting,
+							   (void *) MOTION_HOLD_CB_ARG);
+
+	check_register_settings_error_and_log(err, "MOTION_HOLD_S");
+
+	err = golioth_settings_register_int_with_range(settings,
+							   "MOTION_ACT_THRESH_MG",
+							   1,
+							   MOTION_THRESH_MG_MAX,
+							   on_motion_setting,
+							   (void *) MOTION_ACT_THRESH_CB_ARG);
+
+	check_register_settings_error_and_log(err, "MOTION_ACT_THRESH_MG");
+
+	err = golioth_settings_register_int_with_range(settings,
+							   "MOTION_INACT_THRESH_MG",
+							   1,
+							   MOTION_THRESH_MG_MAX,
+							   on_motion_setting,
+							   (void *) MOTION_INACT_THRESH_CB_ARG);
+
+	check_register_settings_error_and_log(err, "MOTION_INACT_THRESH_MG");
+#endif /* CONFIG_APP_MOTION_TRIGGER */
+
+	if (IS_ENABLED(CONFIG_APP_VIBRATION)) {
+		err = golioth_settings_register_bool(settings,
+						     "VIBRATION_MODE",
+						     on_vibration_mode_setting,
+						     NULL);
+
+		check_register_settings_error_and_log(err, "VIBRATION_MODE");
+	}
 }
@@ -7,13 +7,84 @@
 #ifndef __APP_SETTINGS_H__
 #define __APP_SETTINGS_H__
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <golioth/client.h>
+#include <zephyr/kernel.h>
+
+#include "app_sensors.h"
+
+/* Channels that share a unit share an absolute deadband setting */
+enum app_deadband {
+	APP_DEADBAND_LIGHT,
+	APP_DEADBAND_TEM,
+	APP_DEADBAND_PRE,
+	APP_DEADBAND_HUM,
+	APP_DEADBAND_GAS,
+	APP_DEADBAND_IAQ,
+	APP_DEADBAND_CO2,
+	APP_DEADBAND_VOC,
+	APP_DEADBAND_ACCEL,
+	APP_DEADBAND_COUNT
+};
+
+/* Every value set from Golioth Settings, read together with app_settings_snapshot() */
+struct app_config {
+	int32_t loop_delay_s;
+	int32_t sensor_period_s[APP_SENSORS_GROUP_COUNT]; /* zero means "every LOOP_DELAY_S" */
+	int32_t led_fade_speed_ms;
+	int32_t red_intensity_pct;
+	int32_t green_intensity_pct;
+	int32_t blue_intensity_pct;
+	int32_t batch_max_samples;
+	int32_t batch_max_age_s;
+	int32_t batch_max_bytes;
+	bool compact_encoding;
+	int32_t aggregate_window_s; /* zero means "stream every reading" */
+	bool vibration_mode;
+	int32_t motion_fast_delay_s;
+	int32_t motion_hold_s;
+	int32_t motion_act_thresh_mg;
+	int32_t motion_inact_thresh_mg;
+	int32_t deadband_keepalive;
+	int32_t deadband_rel_pct;
+	int64_t deadband_micro[APP_DEADBAND_COUNT];
+};
+
+/**
+ * Copy a consistent view of all settings without blocking
+ *
+ * Settings are double-buffered: a change is made to the inactive copy and published by bumping
+ * a version, so a reader never waits for a writer and only retries if a change was published
+ * while it was copying.
+ *
+ * @return Version of the copied settings; it changes whenever any setting does
+ */
+uint32_t app_settings_snapshot(struct app_config *cfg);
+
+/** Current settings version, to check cheaply whether a snapshot is stale */
+uint32_t app_settings_version(void);
+
+/** Replace all settings with ones saved before a reboot, without saving them again */
+void app_settings_restore(const struct app_config *saved);
 
 int32_t get_loop_delay_s(void);
+int32_t get_sensor_period_s(enum app_sensors_group group);
+int32_t get_motion_fast_delay_s(void);
+int32_t get_motion_hold_s(void);
+int32_t get_motion_act_thresh_mg(void);
+int32_t get_motion_inact_thresh_mg(void);
 void app_settings_register(struct golioth_client *client);
 int app_led_pwm_init(void);
 void all_leds_on(void);
 void all_leds_off(void);
 
+/**
+ * Turn the LEDs off and wait until the PWM thread has written zero duty
+ *
+ * @retval 0 LEDs are dark
+ * @retval -EAGAIN PWM thread did not acknowledge within @p timeout
+ */
+int all_leds_off_sync(k_timeout_t timeout);
+
 #endif /* __APP_SETTINGS_H__ */
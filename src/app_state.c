@@ -7,12 +7,21 @@
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(app_state, LOG_LEVEL_DBG);
 
+#include <string.h>
 #include <golioth/client.h>
 #include <golioth/lightdb_state.h>
 #include <zcbor_decode.h>
 #include <zcbor_encode.h>
 #include <zephyr/data/json.h>
 #include <zephyr/kernel.h>
+#include <zephyr/net_buf.h>
+#include <zephyr/sys/util.h>
+
+#include "app_boot.h"
+#include "app_persist.h"
+#include "app_radio.h"
+#include "app_state.h"
+#include "app_uplink_buf.h"
 
 #define APP_STATE_DESIRED_PATH "desired"
 #define APP_STATE_ACTUAL_PATH  "state"
@@ -27,6 +36,146 @@ bool _initial_update_pending = true;
 
 static struct golioth_client *client;
 
+/*
+ * Keys are matched by their FNV-1a hash, which the preprocessor computes for the field table so
+ * only the received key is hashed at run time. KEY_HASH() unrolls over KEY_MAX_LEN characters and
+ * fails to compile for longer keys.
+ */
+#define KEY_MAX_LEN	32
+#define FNV_OFFSET	2166136261U
+#define FNV_PRIME	16777619U
+
+#define FNV_STEP(s, i, h)                                                                   \
+	((((uint32_t) (h)) ^ (((i) < sizeof(s) - 1) ? (uint8_t) (s)[(i) % sizeof(s)] : 0U)) * \
+	 (((i) < sizeof(s) - 1) ? FNV_PRIME : 1U))
+#define FNV_STEP4(s, i, h) \
+	FNV_STEP(s, i + 3, FNV_STEP(s, i + 2, FNV_STEP(s, i + 1, FNV_STEP(s, i, h))))
+#define FNV_STEP16(s, i, h) \
+	FNV_STEP4(s, i + 12, FNV_STEP4(s, i + 8, FNV_STEP4(s, i + 4, FNV_STEP4(s, i, h))))
+#define KEY_HASH(s) \
+	(FNV_STEP16(s, 16, FNV_STEP16(s, 0, FNV_OFFSET)) + \
+	 ZERO_OR_COMPILE_ERROR(sizeof(s) <= (KEY_MAX_LEN + 1)))
+
+enum desired_type {
+	DESIRED_TYPE_U16,
+	DESIRED_TYPE_INT32,
+};
+
+/*
+ * A remotely controlled value. The cloud requests a change by writing the key under "desired";
+ * the device applies it, reports it under "state" and writes -1 back to "desired". Because -1
+ * means "no request", ranges must not include it.
+ */
+struct desired_field {
+	const char *name;
+	uint32_t hash;
+	enum desired_type type;
+	int32_t min;
+	int32_t max;
+	void *value; /* guarded by counter_mutex */
+	void (*on_change)(const struct desired_field *field, int32_t value);
+};
+
+#define DESIRED_FIELD(_name, _type, _min, _max, _value, _on_change) \
+	{                                                            \
+		.name = _name,                                       \
+		.hash = KEY_HASH(_name),                             \
+		.type = _type,                                       \
+		.min = _min,                                         \
+		.max = _max,                                         \
+		.value = _value,                                     \
+		.on_change = _on_change,                             \
+	}
+
+static const struct desired_field desired_fields[] = {
+	DESIRED_FIELD(COUNTER_UP_STRING, DESIRED_TYPE_U16, 0, COUNTER_MAX, &_counter_up, NULL),
+	DESIRED_FIELD(COUNTER_DN_STRING, DESIRED_TYPE_U16, 0, COUNTER_MAX, &_counter_dn, NULL),
+};
+
+#define NUM_FIELDS ARRAY_SIZE(desired_fields)
+
+BUILD_ASSERT(NUM_FIELDS < 32, "Fields seen in a desired update are tracked in a uint32_t");
+
+/* Key header and string, then an int32 value at its largest encoded size */
+#define STATE_CBOR_BUF_SIZE (2 + (NUM_FIELDS * (2 + KEY_MAX_LEN + 5)))
+
+/*
+ * Writes to the actual state path are coalesced. A change schedules a write after
+ * CONFIG_APP_STATE_WRITE_DEBOUNCE_MS so a burst of changes costs one request. When the write runs
+ * it is skipped if the values equal the ones LightDB last acknowledged, and deferred until the
+ * acknowledgment if another write is still in flight.
+ */
+struct state_values {
+	int32_t v[NUM_FIELDS];
+};
+
+static void actual_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(actual_work, actual_work_handler);
+
+K_MUTEX_DEFINE(write_mutex);
+static struct state_values acked_values;
+static struct state_values in_flight_values;
+static bool acked_valid;
+static bool in_flight;
+static bool write_after_ack;
+static bool change_pending; /* a change has not been written yet */
+static int64_t pending_since_ms;
+static struct app_state_write_stats write_stats;
+
+static uint32_t key_hash(const uint8_t *key, size_t len)
+{
+	uint32_t hash = FNV_OFFSET;
+
+	for (size_t i = 0; i < len; i++) {
+		hash = (hash ^ key[i]) * FNV_PRIME;
+	}
+
+	return hash;
+}
+
+static const struct desired_field *find_field(const struct zcbor_string *key)
+{
+	uint32_t hash = key_hash(key->value, key->len);
+
+	for (size_t i = 0; i < NUM_FIELDS; i++) {
+		const struct desired_field *field = &desired_fields[i];
+
+		/* Confirm the match so a hash collision can never select the wrong field */
+		if ((field->hash == hash) && (strlen(field->name) == key->len) &&
+		    (memcmp(field->name, key->value, key->len) == 0)) {
+			return field;
+		}
+	}
+
+	return NULL;
+}
+
+/* Caller holds counter_mutex */
+static int32_t field_get(const struct desired_field *field)
+{
+	switch (field->type) {
+	case DESIRED_TYPE_U16:
+		return *(uint16_t *) field->value;
+	case DESIRED_TYPE_INT32:
+	default:
+		return *(int32_t *) field->value;
+	}
+}
+
+/* Caller holds counter_mutex */
+static void field_set(const struct desired_field *field, int32_t value)
+{
+	switch (field->type) {
+	case DESIRED_TYPE_U16:
+		*(uint16_t *) field->value = (uint16_t) value;
+		break;
+	case DESIRED_TYPE_INT32:
+	default:
+		*(int32_t *) field->value = value;
+		break;
+	}
+}
+
 static void async_handler(struct golioth_client *client,
 			  enum golioth_status status,
 			  const struct golioth_coap_rsp_code *coap_rsp_code,
@@ -41,147 +190,276 @@ static void async_handler(struct golioth_client *client,
 	LOG_DBG("State successfully set");
 }
 
-static bool encode_state(zcbor_state_t *zse, int32_t up, int32_t dn)
+static void write_saved(const char *reason)
+{
+	write_stats.saved++;
+	LOG_DBG("Actual state write skipped (%s); %u sent, %u saved", reason, write_stats.sent,
+		write_stats.saved);
+}
+
+static void actual_async_handler(struct golioth_client *client,
+				 enum golioth_status status,
+				 const struct golioth_coap_rsp_code *coap_rsp_code,
+				 const char *path,
+				 void *arg)
+{
+	k_mutex_lock(&write_mutex, K_FOREVER);
+
+	in_flight = false;
+
+	if (status == GOLIOTH_OK) {
+		acked_values = in_flight_values;
+		acked_valid = true;
+		LOG_DBG("State successfully set");
+		app_boot_mark(APP_BOOT_FIRST_ACK);
+	} else {
+		LOG_WRN("Failed to set state: %d", status);
+
+		/* Written again with the next change or reconnect */
+		if (!change_pending) {
+			change_pending = true;
+			pending_since_ms = k_uptime_get();
+		}
+	}
+
+	if (write_after_ack) {
+		write_after_ack = false;
+		k_work_schedule(&actual_work, K_NO_WAIT);
+	}
+
+	k_mutex_unlock(&write_mutex);
+}
+
+/// Encode every field of the table as one map
+///
+/// @param zse    ZCBOR encode state
+/// @param values Value for each field in table order, or NULL to encode -1 for all of them
+static bool encode_state(zcbor_state_t *zse, const struct state_values *values)
 {
-	bool ok = zcbor_map_start_encode(zse, 2) &&
-	          zcbor_tstr_put_lit(zse, COUNTER_UP_STRING) &&
-	          zcbor_int32_put(zse, up) &&
-	          zcbor_tstr_put_lit(zse, COUNTER_DN_STRING) &&
-	          zcbor_int32_put(zse, dn) &&
-	          zcbor_map_end_encode(zse, 2);
-
-	return ok;
+	bool ok = zcbor_map_start_encode(zse, NUM_FIELDS);
+
+	for (size_t i = 0; ok && (i < NUM_FIELDS); i++) {
+		ok = zcbor_tstr_put_term(zse, desired_fields[i].name, KEY_MAX_LEN) &&
+		     zcbor_int32_put(zse, values ? values->v[i] : -1);
+	}
+
+	return ok && zcbor_map_end_encode(zse, NUM_FIELDS);
 }
 
 int app_state_reset_desired(void)
 {
 	bool ok;
-	char cbor_buf[64];
-	ZCBOR_STATE_E(zse, 1, cbor_buf, sizeof(cbor_buf), 1);
+	struct net_buf *buf = app_uplink_buf_alloc(STATE_CBOR_BUF_SIZE);
+
+	if (!buf) {
+		return -ENOMEM;
+	}
 
-	ok = encode_state(zse, -1, -1);
+	ZCBOR_STATE_E(zse, 1, buf->data, net_buf_tailroom(buf), 1);
+
+	ok = encode_state(zse, NULL);
 
 	if (!ok)
 	{
 		LOG_ERR("'%s' reset failed while try to encode CBOR.", APP_STATE_DESIRED_PATH);
+		net_buf_unref(buf);
 		return -ENOMEM;
 	}
 
 	LOG_INF("Resetting \"%s\" LightDB State endpoint to defaults.", APP_STATE_DESIRED_PATH);
 
-	size_t cbor_size = zse->payload - (const uint8_t *) cbor_buf;
+	net_buf_add(buf, zse->payload - buf->data);
 
 	int err = golioth_lightdb_set_async(client,
 					    APP_STATE_DESIRED_PATH,
 					    GOLIOTH_CONTENT_TYPE_CBOR,
-					    cbor_buf,
-					    cbor_size,
+					    buf->data,
+					    buf->len,
 					    async_handler,
 					    NULL);
 	if (err) {
 		LOG_ERR("Unable to write to LightDB State: %d", err);
 	}
 
+	/* The request holds its own copy of the payload */
+	net_buf_unref(buf);
+
 	return err;
 }
 
-int app_state_update_actual(void)
+static void actual_work_handler(struct k_work *work)
 {
+	struct state_values values;
+	struct net_buf *buf = NULL;
+	int64_t hold_ms;
 	bool ok;
-	char cbor_buf[64];
-	ZCBOR_STATE_E(zse, 1, cbor_buf, sizeof(cbor_buf), 1);
+	int err;
 
 	k_mutex_lock(&counter_mutex, K_FOREVER);
-	ok = encode_state(zse, (int32_t) _counter_up, (int32_t) _counter_dn);
+	for (size_t i = 0; i < NUM_FIELDS; i++) {
+		values.v[i] = field_get(&desired_fields[i]);
+	}
 	k_mutex_unlock(&counter_mutex);
 
+	k_mutex_lock(&write_mutex, K_FOREVER);
+
+	if (in_flight) {
+		/* The acknowledgment reschedules us with whatever is current by then. Deferring is
+		 * only a saving once a later value replaces the deferred one; otherwise the rerun
+		 * either sends it or counts it as unchanged.
+		 */
+		if (write_after_ack) {
+			write_saved("replaced while in flight");
+		}
+		write_after_ack = true;
+		goto unlock;
+	}
+
+	if (acked_valid && (memcmp(&values, &acked_values, sizeof(values)) == 0)) {
+		change_pending = false;
+		write_saved("unchanged");
+		goto unlock;
+	}
+
+	hold_ms = app_radio_hold_ms(pending_since_ms);
+	if (hold_ms > 0) {
+		/* Sent when the radio next connects, at the latest when the hold runs out */
+		k_work_schedule(&actual_work, K_MSEC(hold_ms));
+		goto unlock;
+	}
+
+	if (!golioth_client_is_connected(client)) {
+		/* Still pending; app_state_on_connect() schedules it again */
+		goto unlock;
+	}
+
+	buf = app_uplink_buf_alloc(STATE_CBOR_BUF_SIZE);
+	if (!buf) {
+		/* Try again once the pool has drained */
+		k_work_schedule(&actual_work, K_MSEC(CONFIG_APP_STATE_WRITE_DEBOUNCE_MS));
+		goto unlock;
+	}
+
+	ZCBOR_STATE_E(zse, 1, buf->data, net_buf_tailroom(buf), 1);
+
+	ok = encode_state(zse, &values);
+
 	if (!ok)
 	{
 		LOG_ERR("CBOR: failed to encode actual state");
-		return -ENOMEM;
+		goto unlock;
 	}
 
-	size_t cbor_size = zse->payload - (const uint8_t *) cbor_buf;
-	int err = -ENETDOWN;
+	net_buf_add(buf, zse->payload - buf->data);
+
+	err = golioth_lightdb_set_async(client,
+					APP_STATE_ACTUAL_PATH,
+					GOLIOTH_CONTENT_TYPE_CBOR,
+					buf->data,
+					buf->len,
+					actual_async_handler,
+					NULL);
 
-	if (golioth_client_is_connected(client))
+	if (err) {
+		LOG_ERR("Unable to send actual state to LightDB State: %d", err);
+	}
+	else
 	{
-		err = golioth_lightdb_set_async(client,
-						APP_STATE_ACTUAL_PATH,
-						GOLIOTH_CONTENT_TYPE_CBOR,
-						cbor_buf,
-						cbor_size,
-						async_handler,
-						NULL);
+		in_flight = true;
+		in_flight_values = values;
+		change_pending = false;
+		write_stats.sent++;
+		_initial_update_pending = false;
+	}
 
-		if (err) {
-			LOG_ERR("Unable to send actual state to LightDB State: %d", err);
-		}
-		else if (_initial_update_pending)
-		{
-			_initial_update_pending = false;
-		}
+unlock:
+	k_mutex_unlock(&write_mutex);
+
+	if (buf) {
+		/* The request holds its own copy of the payload */
+		net_buf_unref(buf);
 	}
-	return err;
 }
 
-/// Match a given string with ZCBOR decoded string
-///
-/// We don't know which order the key/value pairs will be in CBOR. This function takes a string to
-/// compare, as well as both key/value pairs. It returns a pointer to the value whose key is a
-/// match. If there is no match, NULL will be returned.
-///
-/// @param to_match String to match against the received key
-/// @param zstr0    Pointer to first ZCBOR string
-/// @param v0       Pointer to first ZCBOR value
-/// @param zstr1    Pointer to second ZCBOR string
-/// @param v1       Pointer to second ZCBOR value
-///
-/// @retval Pointer to int32_t value for the matched key or NULL
-static int32_t *find_matching_pointer(const char *to_match, struct zcbor_string *zstr0, int32_t *v0,
-				      struct zcbor_string *zstr1, int32_t *v1)
+void app_state_update_actual(void)
 {
-	if ((strlen(to_match) == zstr0->len) &&
-	    (strncmp(to_match, zstr0->value, zstr0->len) == 0)) {
-		return v0;
+	k_mutex_lock(&write_mutex, K_FOREVER);
+
+	if (!change_pending) {
+		change_pending = true;
+		pending_since_ms = k_uptime_get();
 	}
 
-	if ((strlen(to_match) == zstr1->len) && (strncmp(to_match, zstr1->value, zstr1->len) == 0))
-	{
-		return v1;
+	/* Returns 0 when a write is already scheduled; this change will ride along with it */
+	if (k_work_schedule(&actual_work, K_MSEC(CONFIG_APP_STATE_WRITE_DEBOUNCE_MS)) == 0) {
+		write_saved("debounced");
 	}
 
-	return NULL;
+	k_mutex_unlock(&write_mutex);
+}
+
+void app_state_flush(void)
+{
+	/* Only a write that is already waiting is brought forward */
+	if (k_work_delayable_is_pending(&actual_work)) {
+		k_work_reschedule(&actual_work, K_NO_WAIT);
+	}
+}
+
+void app_state_on_connect(void)
+{
+	k_mutex_lock(&write_mutex, K_FOREVER);
+
+	if (change_pending) {
+		k_work_schedule(&actual_work, K_NO_WAIT);
+	}
+
+	k_mutex_unlock(&write_mutex);
+}
+
+void app_state_get_write_stats(struct app_state_write_stats *stats)
+{
+	k_mutex_lock(&write_mutex, K_FOREVER);
+	*stats = write_stats;
+	k_mutex_unlock(&write_mutex);
 }
 
 /// Validate and store received value
 ///
+/// @param field     Table entry the value was received for
 /// @param new_value Value received in CBOR packet
-/// @param stored_value Pointer for storing validated value
-/// @param str String associated with stored value for use in logging
-static void process_desired_value(int32_t new_value, uint16_t *stored_value, const char *str)
+///
+/// @retval true The stored value changed
+static bool process_desired_value(const struct desired_field *field, int32_t new_value)
 {
-	if (new_value == -1)
-	{
-		return;
-	}
+	bool changed = false;
 
-	if ((new_value < 0) || (new_value > COUNTER_MAX)) {
-		LOG_ERR("'%s' server value out of bounds: %u (expected 0..%u)", str, new_value,
-			COUNTER_MAX);
-		return;
+	if ((new_value < field->min) || (new_value > field->max)) {
+		LOG_ERR("'%s' server value out of bounds: %d (expected %d..%d)", field->name,
+			new_value, field->min, field->max);
+		return false;
 	}
 
-	if (new_value == *stored_value)
-	{
-		LOG_INF("'%s' server value matches current: %u; ignoring.", str, new_value);
+	k_mutex_lock(&counter_mutex, K_FOREVER);
 
+	if (new_value == field_get(field))
+	{
+		LOG_INF("'%s' server value matches current: %d; ignoring.", field->name, new_value);
 	}
 	else
 	{
-		*stored_value = new_value;
-		LOG_INF("Using new '%s' value from server: %u", str, *stored_value);
+		field_set(field, new_value);
+		changed = true;
+		LOG_INF("Using new '%s' value from server: %d", field->name, new_value);
 	}
+
+	k_mutex_unlock(&counter_mutex);
+
+	if (changed && field->on_change) {
+		field->on_change(field, new_value);
+	}
+
+	return changed;
 }
 
 static void app_state_desired_handler(struct golioth_client *client, enum golioth_status status,
@@ -204,17 +482,51 @@ static void app_state_desired_handler(struct golioth_client *client, enum goliot
 
 	ZCBOR_STATE_D(zsd, 2, payload, payload_size, 1, 0);
 
-	struct zcbor_string key0;
-	struct zcbor_string key1;
-	int32_t value0;
-	int32_t value1;
+	/*
+	 * Single pass over a map of any size and order. Keys not in the table and values of the
+	 * wrong type are skipped; fields the map leaves out are left unchanged.
+	 */
+	uint32_t seen = 0;
+	bool requested = false;
+	bool changed = false;
+	bool ok = zcbor_map_start_decode(zsd);
+
+	while (ok && !zcbor_array_at_end(zsd)) {
+		struct zcbor_string key;
+		int32_t value;
+
+		ok = zcbor_tstr_decode(zsd, &key);
+		if (!ok) {
+			break;
+		}
+
+		const struct desired_field *field = find_field(&key);
 
-	int ok = zcbor_map_start_decode(zsd) &&
-		 zcbor_tstr_decode(zsd, &key0) &&
-		 zcbor_int32_decode(zsd, &value0) &&
-		 zcbor_tstr_decode(zsd, &key1) &&
-		 zcbor_int32_decode(zsd, &value1) &&
-		 zcbor_map_end_decode(zsd);
+		if (!field) {
+			LOG_WRN("Ignoring unknown '%s' key: %.*s", APP_STATE_DESIRED_PATH,
+				(int) key.len, (const char *) key.value);
+			ok = zcbor_any_skip(zsd, NULL);
+			continue;
+		}
+
+		if (!zcbor_int32_decode(zsd, &value)) {
+			LOG_WRN("'%s' server value is not an integer; ignoring.", field->name);
+			ok = zcbor_any_skip(zsd, NULL);
+			requested = true;
+			continue;
+		}
+
+		seen |= BIT(field - desired_fields);
+
+		if (value == -1) {
+			continue;
+		}
+
+		requested = true;
+		changed |= process_desired_value(field, value);
+	}
+
+	ok = ok && zcbor_map_end_decode(zsd);
 
 	if (!ok)
 	{
@@ -223,28 +535,29 @@ static void app_state_desired_handler(struct golioth_client *client, enum goliot
 		return;
 	}
 
-	int32_t *up = find_matching_pointer(COUNTER_UP_STRING, &key0, &value0, &key1, &value1);
-	int32_t *dn = find_matching_pointer(COUNTER_DN_STRING, &key0, &value0, &key1, &value1);
+	if (changed)
+	{
+		app_state_update_actual();
+		app_persist_mark_dirty(APP_PERSIST_COUNTERS);
+	}
 
-	if (!up || !dn)
+	if (seen != BIT_MASK(NUM_FIELDS))
 	{
-		LOG_ERR("Did not find expected keys, resetting '%s'", APP_STATE_DESIRED_PATH);
+		/* A partial update was applied above; only warn if nothing was usable */
+		if (seen == 0) {
+			LOG_WRN("Expected keys missing, resetting '%s'", APP_STATE_DESIRED_PATH);
+		} else {
+			LOG_DBG("Partial update applied, resetting '%s'", APP_STATE_DESIRED_PATH);
+		}
 		goto reset_to_default;
 	}
 
-	if ((*up == -1) && (*dn == -1))
+	if (!requested)
 	{
-		/* No changes hae been requested; do nothing */
+		/* No changes have been requested; do nothing */
 		goto check_initial_update;
 	}
 
-	k_mutex_lock(&counter_mutex, K_FOREVER);
-	process_desired_value(*up, &_counter_up, COUNTER_UP_STRING);
-	process_desired_value(*dn, &_counter_dn, COUNTER_DN_STRING);
-	k_mutex_unlock(&counter_mutex);
-
-	app_state_update_actual();
-
 reset_to_default:
 	app_state_reset_desired();
 
@@ -274,7 +587,31 @@ int app_state_counter_change(void)
 
 	k_mutex_unlock(&counter_mutex);
 
-	return app_state_update_actual();
+	app_state_update_actual();
+	app_persist_mark_dirty(APP_PERSIST_COUNTERS);
+
+	return 0;
+}
+
+void app_state_restore_counters(uint16_t up, uint16_t dn)
+{
+	if ((up > COUNTER_MAX) || (dn > COUNTER_MAX)) {
+		LOG_WRN("Ignoring saved counters out of range: %u, %u", up, dn);
+		return;
+	}
+
+	k_mutex_lock(&counter_mutex, K_FOREVER);
+	_counter_up = up;
+	_counter_dn = dn;
+	k_mutex_unlock(&counter_mutex);
+}
+
+void app_state_get_counters(uint16_t *up, uint16_t *dn)
+{
+	k_mutex_lock(&counter_mutex, K_FOREVER);
+	*up = _counter_up;
+	*dn = _counter_dn;
+	k_mutex_unlock(&counter_mutex);
 }
 
 int app_state_observe(struct golioth_client *state_client)
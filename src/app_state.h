@@ -7,9 +7,28 @@
 #ifndef __APP_STATE_H__
 #define __APP_STATE_H__
 
+#include <stdint.h>
 #include <golioth/client.h>
 
+struct app_state_write_stats {
+	uint32_t sent;  /* actual state requests sent */
+	uint32_t saved; /* actual state updates coalesced or skipped */
+};
+
 int app_state_observe(struct golioth_client *state_client);
 int app_state_counter_change(void);
+void app_state_update_actual(void);
+
+/* Write a pending actual state change now instead of at the end of its debounce or hold */
+void app_state_flush(void);
+
+/* Call when the Golioth client connects; writes a change dropped while disconnected */
+void app_state_on_connect(void);
+
+void app_state_get_write_stats(struct app_state_write_stats *stats);
+
+/* Counter values saved across reboots; out of range values are ignored */
+void app_state_restore_counters(uint16_t up, uint16_t dn);
+void app_state_get_counters(uint16_t *up, uint16_t *dn);
 
 #endif /* __APP_STATE_H__ */
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(app_uplink_buf, LOG_LEVEL_DBG);
+
+#include <zephyr/kernel.h>
+#include <zephyr/net_buf.h>
+#include <zephyr/sys/atomic.h>
+
+#include "app_uplink_buf.h"
+
+static void uplink_buf_destroy(struct net_buf *buf);
+
+/*
+ * Payloads range from a 64 byte state write to a full sensor batch, so each buffer is carved to
+ * size from one shared region instead of every block being as large as the largest payload.
+ */
+NET_BUF_POOL_VAR_DEFINE(uplink_pool, CONFIG_APP_UPLINK_BUF_COUNT,
+			CONFIG_APP_UPLINK_BUF_POOL_SIZE, 0, uplink_buf_destroy);
+
+static atomic_t used;
+static atomic_t peak;
+static atomic_t failed;
+
+static void uplink_buf_destroy(struct net_buf *buf)
+{
+	atomic_sub(&used, buf->size);
+	net_buf_destroy(buf);
+}
+
+struct net_buf *app_uplink_buf_alloc(size_t size)
+{
+	struct net_buf *buf = net_buf_alloc_len(&uplink_pool, size, K_NO_WAIT);
+	atomic_val_t now;
+	atomic_val_t old;
+
+	if (!buf) {
+		atomic_inc(&failed);
+		LOG_WRN("Uplink buffer pool exhausted: %zu bytes wanted, %ld in use", size,
+			(long) atomic_get(&used));
+		return NULL;
+	}
+
+	now = atomic_add(&used, buf->size) + buf->size;
+
+	do {
+		old = atomic_get(&peak);
+	} while ((now > old) && !atomic_cas(&peak, old, now));
+
+	return buf;
+}
+
+void app_uplink_buf_get_stats(struct app_uplink_buf_stats *stats)
+{
+	stats->used = atomic_get(&used);
+	stats->peak = atomic_get(&peak);
+	stats->failed = atomic_get(&failed);
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __APP_UPLINK_BUF_H__
+#define __APP_UPLINK_BUF_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/net_buf.h>
+
+struct app_uplink_buf_stats {
+	uint32_t used;   /* payload bytes currently taken from the pool */
+	uint32_t peak;   /* most payload bytes taken at once since boot */
+	uint32_t failed; /* allocations refused because the pool was full */
+};
+
+/**
+ * Take a buffer of @p size bytes from the pool shared by all uplink encoders
+ *
+ * Encoders write their payload straight into the buffer and pass it on to the uplink path,
+ * which drops the reference with net_buf_unref() once the payload has been sent or queued.
+ * Never waits.
+ *
+ * @return Buffer holding one reference, or NULL if the pool is exhausted
+ */
+struct net_buf *app_uplink_buf_alloc(size_t size);
+
+void app_uplink_buf_get_stats(struct app_uplink_buf_stats *stats);
+
+#endif /* __APP_UPLINK_BUF_H__ */
@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(app_vibration, LOG_LEVEL_DBG);
+
+#include <math.h>
+#include <stdlib.h>
+#include <golioth/client.h>
+#include <golioth/stream.h>
+#include <zcbor_encode.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net_buf.h>
+#include <zephyr/sys/util.h>
+
+#include "app_uplink_buf.h"
+#include "app_vibration.h"
+
+/*
+ * A window of accelerometer samples is taken at a high output data rate and reduced on the
+ * device to a handful of numbers: per-axis RMS, peak and crest factor of the AC component, and
+ * the energy in CONFIG_APP_VIBRATION_BANDS equal-width frequency bands from a Q15 FFT. All
+ * amplitudes are in mm/s^2 and band energies in (mm/s^2)^2; the bands add up to the sum of the
+ * per-axis mean squares.
+ */
+
+#define WINDOW	 CONFIG_APP_VIBRATION_WINDOW
+#define BANDS	 CONFIG_APP_VIBRATION_BANDS
+#define ODR_HZ	 CONFIG_APP_VIBRATION_ODR_HZ
+#define NUM_AXES 3
+
+/* Keys and headers, then uint32 and float16 values at their largest encoded size */
+#define FEATURES_CBOR_MAX_LEN (64 + (2 * NUM_AXES * 5) + (NUM_AXES * 3) + (BANDS * 5))
+
+BUILD_ASSERT(IS_POWER_OF_TWO(WINDOW), "Vibration window must be a power of two");
+BUILD_ASSERT(((WINDOW / 2) % BANDS) == 0, "Bands must evenly split the spectrum");
+
+struct vibration_features {
+	uint32_t rms[NUM_AXES];
+	uint32_t peak[NUM_AXES];
+	uint32_t bands[BANDS];
+	uint32_t missed; /* sample periods lost to slow fetches */
+};
+
+static int16_t samples[NUM_AXES][WINDOW];
+static int16_t fft_re[WINDOW];
+static int16_t fft_im[WINDOW];
+static int16_t twiddle_cos[WINDOW / 2];
+static int16_t twiddle_sin[WINDOW / 2];
+static bool twiddles_ready;
+
+static void init_twiddles(void)
+{
+	for (int k = 0; k < (WINDOW / 2); k++) {
+		float angle = (2.0f * (float) M_PI * k) / WINDOW;
+
+		twiddle_cos[k] = (int16_t) lroundf(cosf(angle) * INT16_MAX);
+		twiddle_sin[k] = (int16_t) lroundf(sinf(angle) * INT16_MAX);
+	}
+
+	twiddles_ready = true;
+}
+
+/* In-place radix-2 FFT; each stage halves its output, so the result is scaled by 1/WINDOW */
+static void fft_q15(int16_t *re, int16_t *im)
+{
+	for (int i = 1, j = 0; i < WINDOW; i++) {
+		int bit = WINDOW >> 1;
+
+		for (; j & bit; bit >>= 1) {
+			j ^= bit;
+		}
+		j ^= bit;
+
+		if (i < j) {
+			int16_t tmp = re[i];
+
+			re[i] = re[j];
+			re[j] = tmp;
+			tmp = im[i];
+			im[i] = im[j];
+			im[j] = tmp;
+		}
+	}
+
+	for (int len = 2; len <= WINDOW; len <<= 1) {
+		int half = len >> 1;
+		int step = WINDOW / len;
+
+		for (int i = 0; i < WINDOW; i += len) {
+			for (int k = 0; k < half; k++) {
+				int a = i + k;
+				int b = a + half;
+				int32_t wr = twiddle_cos[k * step];
+				int32_t ws = twiddle_sin[k * step];
+				int32_t tr = (wr * re[b] + ws * im[b]) >> 15;
+				int32_t ti = (wr * im[b] - ws * re[b]) >> 15;
+
+				re[b] = (re[a] - tr) >> 1;
+				im[b] = (im[a] - ti) >> 1;
+				re[a] = (re[a] + tr) >> 1;
+				im[a] = (im[a] + ti) >> 1;
+			}
+		}
+	}
+}
+
+static uint32_t isqrt64(uint64_t x)
+{
+	uint64_t res = 0;
+	uint64_t bit = 1ULL << 62;
+
+	while (bit > x) {
+		bit >>= 2;
+	}
+
+	while (bit) {
+		if (x >= res + bit) {
+			x -= res + bit;
+			res = (res >> 1) + bit;
+		} else {
+			res >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return (uint32_t) res;
+}
+
+static void analyze_axis(const int16_t *x, struct vibration_features *f, int axis,
+			 uint64_t *band_energy)
+{
+	uint64_t band_raw[BANDS] = {0};
+	uint64_t sum_sq = 0;
+	uint32_t peak = 0;
+	int32_t sum = 0;
+	int up = 0;
+	int down = 0;
+
+	for (int i = 0; i < WINDOW; i++) {
+		sum += x[i];
+	}
+
+	int32_t mean = sum / WINDOW;
+
+	for (int i = 0; i < WINDOW; i++) {
+		int32_t d = x[i] - mean;
+
+		sum_sq += (uint64_t) ((int64_t) d * d);
+		peak = MAX(peak, (uint32_t) abs(d));
+	}
+
+	f->rms[axis] = isqrt64(sum_sq / WINDOW);
+	f->peak[axis] = peak;
+
+	/* Block floating point: scale the AC signal to fill the Q15 range before the FFT */
+	if (peak > INT16_MAX) {
+		down = 1;
+	} else {
+		while ((up < 14) && ((peak << (up + 1)) <= INT16_MAX)) {
+			up++;
+		}
+	}
+
+	for (int i = 0; i < WINDOW; i++) {
+		fft_re[i] = (int16_t) (((x[i] - mean) * (1 << up)) >> down);
+		fft_im[i] = 0;
+	}
+
+	fft_q15(fft_re, fft_im);
+
+	/* Skip DC (removed above) and Nyquist; each remaining bin stands for itself and its
+	 * mirror image, hence the factor of two below.
+	 */
+	for (int k = 1; k < (WINDOW / 2); k++) {
+		int32_t re = fft_re[k];
+		int32_t im = fft_im[k];
+
+		band_raw[(k * BANDS) / (WINDOW / 2)] += (uint64_t) (re * re + im * im);
+	}
+
+	for (int b = 0; b < BANDS; b++) {
+		band_energy[b] += ((band_raw[b] * 2) << (2 * down)) >> (2 * up);
+	}
+}
+
+static void async_error_handler(struct golioth_client *client, enum golioth_status status,
+				const struct golioth_coap_rsp_code *coap_rsp_code, const char *path,
+				void *arg)
+{
+	if (status != GOLIOTH_OK) {
+		LOG_ERR("Async task failed: %d", status);
+	}
+}
+
+static int capture_window(const struct device *accel, struct vibration_features *f)
+{
+	struct sensor_value odr = {.val1 = ODR_HZ};
+	struct sensor_value idle_odr = {
+		.val1 = CONFIG_APP_VIBRATION_IDLE_ODR_MHZ / 1000,
+		.val2 = (CONFIG_APP_VIBRATION_IDLE_ODR_MHZ % 1000) * 1000,
+	};
+	struct k_timer timer;
+	int err;
+
+	err = sensor_attr_set(accel, SENSOR_CHAN_ACCEL_XYZ, SENSOR_ATTR_SAMPLING_FREQUENCY, &odr);
+	if (err) {
+		LOG_ERR("Unable to set accelerometer ODR to %d Hz: %d", ODR_HZ, err);
+		return err;
+	}
+
+	k_timer_init(&timer, NULL, NULL);
+	k_timer_start(&timer, K_USEC(USEC_PER_SEC / ODR_HZ), K_USEC(USEC_PER_SEC / ODR_HZ));
+
+	for (int i = 0; i < WINDOW; i++) {
+		struct sensor_value xyz[NUM_AXES];
+		uint32_t periods = k_timer_status_sync(&timer);
+
+		f->missed += periods - 1;
+
+		err = sensor_sample_fetch(accel);
+		if (!err) {
+			err = sensor_channel_get(accel, SENSOR_CHAN_ACCEL_XYZ, xyz);
+		}
+		if (err) {
+			LOG_ERR("Error fetching vibration sample %d: %d", i, err);
+			break;
+		}
+
+		for (int axis = 0; axis < NUM_AXES; axis++) {
+			int64_t milli = sensor_value_to_milli(&xyz[axis]);
+
+			samples[axis][i] = (int16_t) CLAMP(milli, INT16_MIN, INT16_MAX);
+		}
+	}
+
+	k_timer_stop(&timer);
+
+	if (sensor_attr_set(accel, SENSOR_CHAN_ACCEL_XYZ, SENSOR_ATTR_SAMPLING_FREQUENCY,
+			    &idle_odr)) {
+		LOG_WRN("Unable to restore accelerometer ODR");
+	}
+
+	return err;
+}
+
+static bool put_uint_array(zcbor_state_t *zse, const uint32_t *values, size_t count)
+{
+	bool ok = zcbor_list_start_encode(zse, count);
+
+	for (size_t i = 0; ok && (i < count); i++) {
+		ok = zcbor_uint32_put(zse, values[i]);
+	}
+
+	return ok && zcbor_list_end_encode(zse, count);
+}
+
+static int encode_features(const struct vibration_features *f, uint8_t *buf, size_t buf_len)
+{
+	bool ok;
+
+	ZCBOR_STATE_E(zse, 2, buf, buf_len, 1);
+
+	ok = zcbor_map_start_encode(zse, 6) &&
+	     zcbor_tstr_put_lit(zse, "odr") && zcbor_uint32_put(zse, ODR_HZ) &&
+	     zcbor_tstr_put_lit(zse, "n") && zcbor_uint32_put(zse, WINDOW) &&
+	     zcbor_tstr_put_lit(zse, "rms") && put_uint_array(zse, f->rms, NUM_AXES) &&
+	     zcbor_tstr_put_lit(zse, "peak") && put_uint_array(zse, f->peak, NUM_AXES) &&
+	     zcbor_tstr_put_lit(zse, "crest") && zcbor_list_start_encode(zse, NUM_AXES);
+
+	for (int axis = 0; ok && (axis < NUM_AXES); axis++) {
+		float crest = f->rms[axis] ? ((float) f->peak[axis] / f->rms[axis]) : 0.0f;
+
+		ok = zcbor_float16_put(zse, crest);
+	}
+
+	ok = ok && zcbor_list_end_encode(zse, NUM_AXES) &&
+	     zcbor_tstr_put_lit(zse, "bands") && put_uint_array(zse, f->bands, BANDS) &&
+	     zcbor_map_end_encode(zse, 6);
+
+	if (!ok) {
+		LOG_ERR("Failed to encode vibration features");
+		return -ENOMEM;
+	}
+
+	return zse->payload - buf;
+}
+
+int app_vibration_capture_and_stream(struct golioth_client *client, const struct device *accel)
+{
+	struct vibration_features f = {0};
+	uint64_t band_energy[BANDS] = {0};
+	struct net_buf *buf;
+	uint32_t start;
+	int err;
+
+	if (!twiddles_ready) {
+		init_twiddles();
+	}
+
+	err = capture_window(accel, &f);
+	if (err) {
+		return err;
+	}
+
+	start = k_cycle_get_32();
+
+	for (int axis = 0; axis < NUM_AXES; axis++) {
+		analyze_axis(samples[axis], &f, axis, band_energy);
+	}
+
+	for (int b = 0; b < BANDS; b++) {
+		f.bands[b] = (uint32_t) MIN(band_energy[b], UINT32_MAX);
+	}
+
+	LOG_DBG("Vibration RMS %u/%u/%u peak %u/%u/%u mm/s^2, analysed in %u us, %u missed",
+		f.rms[0], f.rms[1], f.rms[2], f.peak[0], f.peak[1], f.peak[2],
+		k_cyc_to_us_floor32(k_cycle_get_32() - start), f.missed);
+
+	if (!golioth_client_is_connected(client)) {
+		LOG_DBG("No connection available, skipping sending vibration features");
+		return -ENOTCONN;
+	}
+
+	buf = app_uplink_buf_alloc(FEATURES_CBOR_MAX_LEN);
+	if (!buf) {
+		return -ENOMEM;
+	}
+
+	err = encode_features(&f, buf->data, net_buf_tailroom(buf));
+	if (err < 0) {
+		goto out;
+	}
+
+	net_buf_add(buf, err);
+
+	LOG_DBG("Streaming %u bytes of vibration features (raw window %zu bytes)", buf->len,
+		sizeof(samples));
+
+	err = golioth_stream_set_async(client, "vibration", GOLIOTH_CONTENT_TYPE_CBOR, buf->data,
+				       buf->len, async_error_handler, NULL);
+	if (err) {
+		LOG_ERR("Failed to send vibration features to Golioth: %d", err);
+	}
+
+out:
+	net_buf_unref(buf);
+
+	return err;
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __APP_VIBRATION_H__
+#define __APP_VIBRATION_H__
+
+#include <errno.h>
+#include <golioth/client.h>
+#include <zephyr/device.h>
+
+#ifdef CONFIG_APP_VIBRATION
+
+/**
+ * Capture one window of accelerometer data at the vibration ODR and stream its features
+ *
+ * Blocks for the length of the window (CONFIG_APP_VIBRATION_WINDOW samples at
+ * CONFIG_APP_VIBRATION_ODR_HZ). Only the per-axis RMS, peak and crest factor and the FFT
+ * band energies are sent, to the "vibration" stream path.
+ */
+int app_vibration_capture_and_stream(struct golioth_client *client, const struct device *accel);
+
+#else
+
+static inline int app_vibration_capture_and_stream(struct golioth_client *client,
+						   const struct device *accel)
+{
+	return -ENOTSUP;
+}
+
+#endif /* CONFIG_APP_VIBRATION */
+
+#endif /* __APP_VIBRATION_H__ */
@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2025 Golioth, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Stand-ins for the Thingy91 sensors on boards that do not have them, such as native_sim.
+ * They bind to the real compatibles with the real drivers disabled, so the application finds
+ * them exactly as it would the hardware. Every fetch moves each channel along a slow triangle
+ * wave with a little pseudo-random noise, enough to exercise the deadband and encoders.
+ */
+
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+#define FAKE_MAX_CHANNELS 4
+#define FAKE_WAVE_PERIOD  64 /* fetches per triangle wave */
+
+struct fake_channel {
+	enum sensor_channel chan;
+	int32_t base_milli;
+	int32_t swing_milli; /* peak deviation of the wave from base */
+	int32_t noise_milli;
+};
+
+struct fake_sensor_config {
+	const struct fake_channel *channels;
+	size_t count;
+	enum sensor_channel xyz; /* channel returning the first three together, if any */
+};
+
+struct fake_sensor_data {
+	uint32_t fetches;
+	uint32_t rng;
+	int64_t milli[FAKE_MAX_CHANNELS];
+};
+
+static uint32_t xorshift32(uint32_t *state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+
+	return x;
+}
+
+static int fake_sample_fetch(const struct device *dev, enum sensor_channel chan)
+{
+	const struct fake_sensor_config *cfg = dev->config;
+	struct fake_sensor_data *data = dev->data;
+	int32_t phase = (int32_t) (data->fetches++ % FAKE_WAVE_PERIOD);
+	/* -FAKE_WAVE_PERIOD / 2 .. FAKE_WAVE_PERIOD / 2 and back */
+	int32_t wave = (phase < (FAKE_WAVE_PERIOD / 2)) ? (2 * phase) - (FAKE_WAVE_PERIOD / 2)
+							 : (3 * FAKE_WAVE_PERIOD / 2) - (2 * phase);
+
+	for (size_t i = 0; i < cfg->count; i++) {
+		const struct fake_channel *ch = &cfg->channels[i];
+		int32_t noise = 0;
+
+		if (ch->noise_milli > 0) {
+			noise = (int32_t) (xorshift32(&data->rng) % (2 * ch->noise_milli + 1)) -
+				ch->noise_milli;
+		}
+
+		int64_t offset = ((int64_t) ch->swing_milli * wave) / (FAKE_WAVE_PERIOD / 2);
+
+		data->milli[i] = ch->base_milli + offset + noise;
+	}
+
+	return 0;
+}
+
+static int fake_channel_get(const struct device *dev, enum sensor_channel chan,
+			    struct sensor_value *val)
+{
+	const struct fake_sensor_config *cfg = dev->config;
+	struct fake_sensor_data *data = dev->data;
+
+	if ((cfg->xyz != SENSOR_CHAN_ALL) && (chan == cfg->xyz) && (cfg->count >= 3)) {
+		for (size_t i = 0; i < 3; i++) {
+			sensor_value_from_milli(&val[i], data->milli[i]);
+		}
+		return 0;
+	}
+
+	for (size_t i = 0; i < cfg->count; i++) {
+		if (cfg->channels[i].chan == chan) {
+			return sensor_value_from_milli(val, data->milli[i]);
+		}
+	}
+
+	return -ENOTSUP;
+}
+
+static const struct sensor_driver_api fake_sensor_api = {
+	.sample_fetch = fake_sample_fetch,
+	.channel_get = fake_channel_get,
+};
+
+static int fake_sensor_init(const struct device *dev)
+{
+	struct fake_sensor_data *data = dev->data;
+
+	/* Any nonzero seed; the device address keeps instances apart */
+	data->rng = (uint32_t) (uintptr_t) dev | 1;
+
+	return 0;
+}
+
+#define FAKE_SENSOR_DEFINE(kind, inst, chans, xyz_chan)                                            \
+	BUILD_ASSERT(ARRAY_SIZE(chans) <= FAKE_MAX_CHANNELS);                                      \
+	static struct fake_sensor_data fake_##kind##_data_##inst;                                  \
+	static const struct fake_sensor_config fake_##kind##_config_##inst = {                     \
+		.channels = chans,                                                                 \
+		.count = ARRAY_SIZE(chans),                                                        \
+		.xyz = xyz_chan,                                                                   \
+	};                                                                                         \
+	DEVICE_DT_INST_DEFINE(inst, fake_sensor_init, NULL, &fake_##kind##_data_##inst,            \
+			      &fake_##kind##_config_##inst, POST_KERNEL,                           \
+			      CONFIG_SENSOR_INIT_PRIORITY, &fake_sensor_api);
+
+/* BH1749: raw counts, with the LEDs' effect left out */
+static const struct fake_channel light_channels[] = {
+	{SENSOR_CHAN_RED, 420000, 150000, 4000},
+	{SENSOR_CHAN_GREEN, 610000, 200000, 4000},
+	{SENSOR_CHAN_BLUE, 380000, 120000, 4000},
+	{SENSOR_CHAN_IR, 90000, 30000, 2000},
+};
+
+/* BME680: degrees Celsius, kPa, percent and ohms */
+static const struct fake_channel weather_channels[] = {
+	{SENSOR_CHAN_AMBIENT_TEMP, 22500, 2000, 50},
+	{SENSOR_CHAN_PRESS, 101325, 400, 5},
+	{SENSOR_CHAN_HUMIDITY, 45000, 8000, 200},
+	{SENSOR_CHAN_GAS_RES, 52000000, 6000000, 100000},
+};
+
+/* ADXL362: m/s^2, lying flat with a little movement */
+static const struct fake_channel accel_channels[] = {
+	{SENSOR_CHAN_ACCEL_X, 0, 150, 40},
+	{SENSOR_CHAN_ACCEL_Y, 0, 150, 40},
+	{SENSOR_CHAN_ACCEL_Z, 9807, 100, 40},
+};
+
+#define DT_DRV_COMPAT rohm_bh1749
+#define FAKE_LIGHT_DEFINE(inst)                                                                    \
+	FAKE_SENSOR_DEFINE(light, inst, light_channels, SENSOR_CHAN_ALL)
+DT_INST_FOREACH_STATUS_OKAY(FAKE_LIGHT_DEFINE)
+#undef DT_DRV_COMPAT
+
+#define DT_DRV_COMPAT bosch_bme680
+#define FAKE_WEATHER_DEFINE(inst)                                                                  \
+	FAKE_SENSOR_DEFINE(weather, inst, weather_channels, SENSOR_CHAN_ALL)
+DT_INST_FOREACH_STATUS_OKAY(FAKE_WEATHER_DEFINE)
+#undef DT_DRV_COMPAT
+
+#define DT_DRV_COMPAT adi_adxl362
+#define FAKE_ACCEL_DEFINE(inst)                                                                    \
+	FAKE_SENSOR_DEFINE(accel, inst, accel_channels, SENSOR_CHAN_ACCEL_XYZ)
+DT_INST_FOREACH_STATUS_OKAY(FAKE_ACCEL_DEFINE)
+#undef DT_DRV_COMPAT
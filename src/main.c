@@ -8,8 +8,15 @@
 LOG_MODULE_REGISTER(thingy91_golioth, LOG_LEVEL_DBG);
 
 #include <app_version.h>
+#include "app_boot.h"
 #include "app_buzzer.h"
+#include "app_log.h"
+#include "app_metrics.h"
+#include "app_motion.h"
+#include "app_radio.h"
 #include "app_rpc.h"
+#include "app_schedule.h"
+#include "app_sample_queue.h"
 #include "app_settings.h"
 #include "app_state.h"
 #include "app_sensors.h"
@@ -35,7 +42,6 @@ static const char *_current_version =
 	STRINGIFY(APP_VERSION_MAJOR) "." STRINGIFY(APP_VERSION_MINOR) "." STRINGIFY(APP_PATCHLEVEL);
 
 static struct golioth_client *client;
-K_SEM_DEFINE(connected, 0, 1);
 
 static k_tid_t _system_thread;
 
@@ -53,8 +59,9 @@ static void on_client_event(struct golioth_client *client, enum golioth_client_e
 	bool is_connected = (event == GOLIOTH_CLIENT_EVENT_CONNECTED);
 
 	if (is_connected) {
-		k_sem_give(&connected);
+		app_boot_mark(APP_BOOT_DTLS);
 		app_led_pwm_init();
+		app_state_on_connect();
 	}
 	LOG_INF("Golioth client %s", is_connected ? "connected" : "disconnected");
 }
@@ -70,6 +77,9 @@ static void start_golioth_client(void)
 	/* Register Golioth on_connect callback */
 	golioth_client_register_event_callback(client, on_client_event, NULL);
 
+	/* Rate-limit logs sent to Golioth */
+	app_log_uplink_init(client);
+
 	/* Initialize DFU components */
 	golioth_fw_update_init(client, _current_version);
 
@@ -86,6 +96,9 @@ static void start_golioth_client(void)
 
 	/* Register RPC service */
 	app_rpc_register(client);
+
+	/* Stream runtime metrics, if enabled */
+	app_metrics_init(client);
 }
 
 #ifdef CONFIG_SOC_SERIES_NRF91X
@@ -97,6 +110,8 @@ static void lte_handler(const struct lte_lc_evt *const evt)
 		if ((evt->nw_reg_status == LTE_LC_NW_REG_REGISTERED_HOME) ||
 		    (evt->nw_reg_status == LTE_LC_NW_REG_REGISTERED_ROAMING)) {
 
+			app_boot_mark(APP_BOOT_NETWORK);
+
 			/* Change the state of the Internet LED on Ostentus */
 			IF_ENABLED(CONFIG_LIB_OSTENTUS, (ostentus_led_internet_set(o_dev, 1);));
 
@@ -126,9 +141,44 @@ static void log_modem_firmware_version(void)
 	/* Log modem firmware version */
 	modem_info_string_get(MODEM_INFO_FW_VERSION, sbuf, sizeof(sbuf));
 	LOG_INF("Modem firmware version: %s", sbuf);
+
+	app_boot_mark(APP_BOOT_MODEM);
 }
 #endif
 
+/*
+ * Runs on its own work queue so neither the main thread nor the system work queue waits for the
+ * network; samples taken before the client connects go to the offline queue.
+ */
+static void net_start_work_handler(struct k_work *work)
+{
+	IF_ENABLED(CONFIG_MODEM_INFO, (log_modem_firmware_version();));
+
+#ifdef CONFIG_SOC_SERIES_NRF91X
+	/* Hold uplinks for PSM/eDRX windows; the timers are requested before connecting */
+	int err = app_radio_init();
+
+	if (err) {
+		LOG_ERR("Unable to request LTE power saving: %d", err);
+	}
+
+	/* Golioth Client will start automatically when LTE connects */
+	LOG_INF("Connecting to LTE, this may take some time...");
+	lte_lc_connect_async(lte_handler);
+#else
+	/* Blocks until the network interface is up; only the net_start queue waits for it */
+	net_connect();
+	app_boot_mark(APP_BOOT_NETWORK);
+
+	/* Create and start a Golioth Client; it connects in the background */
+	start_golioth_client();
+#endif /* CONFIG_SOC_SERIES_NRF91X */
+}
+
+static K_WORK_DEFINE(net_start_work, net_start_work_handler);
+static K_THREAD_STACK_DEFINE(net_start_stack, CONFIG_APP_NET_START_STACK_SIZE);
+static struct k_work_q net_start_queue;
+
 void button_pressed(const struct device *dev, struct gpio_callback *cb, uint32_t pins)
 {
 	uint32_t button_kernel_time = k_cycle_get_32();
@@ -146,34 +196,31 @@ int main(void)
 	LOG_DBG("Start Thingy91 Golioth sample");
 
 	LOG_INF("Firmware version: %s", _current_version);
-	IF_ENABLED(CONFIG_MODEM_INFO, (log_modem_firmware_version();));
 
 	/* Get system thread id so loop delay change event can wake main */
 	_system_thread = k_current_get();
 
-#ifdef CONFIG_SOC_SERIES_NRF91X
-	/* Start LTE asynchronously if the nRF9160 is used.
-	 * Golioth Client will start automatically when LTE connects
-	 */
-
-	LOG_INF("Connecting to LTE, this may take some time...");
-	lte_lc_connect_async(lte_handler);
-
-#else
-	/* If nRF9160 is not used, start the Golioth Client and block until connected */
-
-	/* Start Golioth client */
-	golioth_system_client_start();
+	/* Bring the network up in the background; nothing below waits for it */
+	if (!IS_ENABLED(CONFIG_APP_SENSORS_BENCHMARK)) {
+		struct k_work_queue_config cfg = {.name = "net_start"};
 
-	/* Block until connected to Golioth */
-	k_sem_take(&connected, K_FOREVER);
+		k_work_queue_start(&net_start_queue, net_start_stack,
+				   K_THREAD_STACK_SIZEOF(net_start_stack),
+				   CONFIG_MAIN_THREAD_PRIORITY, &cfg);
+		k_work_submit_to_queue(&net_start_queue, &net_start_work);
+	}
 
-	/* Start Golioth client */
-	start_golioth_client();
+	/* Samples taken while offline are kept in flash until they can be uploaded */
+	err = app_sample_queue_init();
+	if (err) {
+		LOG_ERR("Unable to initialize sample queue: %d", err);
+	}
 
-	/* Block until connected to Golioth */
-	k_sem_take(&connected, K_FOREVER);
-#endif /* CONFIG_SOC_SERIES_NRF91X */
+#ifdef CONFIG_APP_SENSORS_BENCHMARK
+	/* Measure the sensor path offline, then stop; see overlay-benchmark.conf */
+	app_sensors_benchmark();
+	return 0;
+#endif
 
 	err = app_buzzer_init();
 	if (err) {
@@ -198,10 +245,36 @@ int main(void)
 	gpio_init_callback(&button_cb_data, button_pressed, BIT(user_btn.pin));
 	gpio_add_callback(user_btn.port, &button_cb_data);
 
+	/* Accelerometer interrupts shorten the sensor periods while the device is moving */
+	err = app_motion_init();
+	if (err) {
+		LOG_ERR("Unable to set up motion-triggered sampling: %d", err);
+	}
+
 	while (true) {
-		app_sensors_read_and_stream();
-		app_state_counter_change();
+		uint32_t groups = app_schedule_take_due(k_uptime_get());
+		bool window = app_radio_take_window();
+		bool batch_due = app_sensors_batch_due();
+
+		if (window) {
+			/* The radio is up or held uplinks cannot wait any longer */
+			app_state_flush();
+		}
+
+		if ((groups == 0) && (window || batch_due)) {
+			/* Woken to send what is held, not to take a reading */
+			app_sensors_flush();
+		} else {
+			/* Woken before any deadline by the button, motion or a setting change */
+			if (groups == 0) {
+				groups = APP_SENSORS_ALL;
+			}
+
+			app_sensors_read_and_stream(groups);
+			app_boot_mark(APP_BOOT_FIRST_SAMPLE);
+			app_state_counter_change();
+		}
 
-		k_sleep(K_SECONDS(get_loop_delay_s()));
+		k_sleep(K_TIMEOUT_ABS_MS(app_schedule_next_ms()));
 	}
 }
@@ -0,0 +1,416 @@
+#!/usr/bin/env python3
+# Copyright (c) 2025 Golioth, Inc.
+# SPDX-License-Identifier: Apache-2.0
+
+"""Local stand-in for the Golioth cloud.
+
+Serves the CoAP paths this application uses, as the Golioth Firmware SDK
+v0.18.1 addresses them, so request round trips, queueing under load and
+reconnects can be measured without the real cloud:
+
+  .s/<path>     LightDB Stream (sensor, batch, batch_compact, vibration,
+                metrics, log)
+  .d/state      LightDB State actual values
+  .d/desired    LightDB State desired values, observable
+  .c            Settings, observable; the device answers on .c/status
+  .rpc          RPC calls, observable; the device answers on .rpc/status
+  .logs         Log service
+  .u/desired    Firmware manifest, observable and always empty
+
+Requests from the device are timed from arrival to response, which is the
+configured --delay-ms/--jitter-ms plus the stand-in's own time. Changes the
+stand-in pushes (RPC calls, settings and desired state) are timed until the
+device acknowledges them at the application level, which covers the network,
+the SDK and the application. Device requests are also grouped into wake-ups,
+bursts separated by --burst-gap-s of quiet, to count requests per cycle.
+
+Needs aiocoap with DTLS server support (pip install "aiocoap[tinydtls]") and
+cbor2.
+"""
+
+import argparse
+import asyncio
+import bisect
+import itertools
+import logging
+import random
+import signal
+import time
+from collections import defaultdict
+
+import aiocoap
+import aiocoap.resource as resource
+import cbor2
+from aiocoap import interfaces
+from aiocoap.numbers.contentformat import ContentFormat
+
+BUCKETS_MS = (1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000)
+
+CBOR = ContentFormat.CBOR
+
+
+def now_ms():
+    return time.monotonic() * 1000.0
+
+
+class Histogram:
+    def __init__(self):
+        self.counts = [0] * (len(BUCKETS_MS) + 1)
+        self.samples = []
+
+    def add(self, ms):
+        self.counts[bisect.bisect_left(BUCKETS_MS, ms)] += 1
+        self.samples.append(ms)
+
+    def percentile(self, pct):
+        ordered = sorted(self.samples)
+        return ordered[min(len(ordered) - 1, int(len(ordered) * pct / 100))]
+
+    def format(self, name):
+        n = len(self.samples)
+        lines = [f"{name}: n={n} avg={sum(self.samples) / n:.1f} ms "
+                 f"p50={self.percentile(50):.1f} p90={self.percentile(90):.1f} "
+                 f"p99={self.percentile(99):.1f} max={max(self.samples):.1f}"]
+        peak = max(self.counts)
+        for i, count in enumerate(self.counts):
+            if count == 0:
+                continue
+            label = f"<={BUCKETS_MS[i]}" if i < len(BUCKETS_MS) else f">{BUCKETS_MS[-1]}"
+            bar = "#" * max(1, round(40 * count / peak))
+            lines.append(f"  {label:>7} ms {count:6d} {bar}")
+        return "\n".join(lines)
+
+
+class Stats:
+    def __init__(self, burst_gap_s):
+        self.burst_gap_ms = burst_gap_s * 1000.0
+        self.service = defaultdict(Histogram)  # device request -> time to respond
+        self.round_trip = defaultdict(Histogram)  # pushed change -> device acknowledgment
+        self.bytes = defaultdict(int)
+        self.errors_injected = 0
+        self.remotes = {}
+        self.bursts = []
+        self.burst_count = 0
+        self.last_request_ms = None
+
+    def request(self, op, request):
+        t = now_ms()
+
+        remote = str(request.remote.hostinfo)
+        if remote not in self.remotes:
+            logging.info("New session from %s (%d so far)", remote, len(self.remotes) + 1)
+            self.remotes[remote] = t
+
+        if self.last_request_ms is not None and (t - self.last_request_ms) > self.burst_gap_ms:
+            self.bursts.append(self.burst_count)
+            self.burst_count = 0
+        self.burst_count += 1
+        self.last_request_ms = t
+
+        self.bytes[op] += len(request.payload)
+        return t
+
+    def report(self):
+        lines = ["", "==== Golioth stand-in report ===="]
+        lines.append(f"Sessions: {len(self.remotes)} (each new DTLS session after the first "
+                     "is a reconnect)")
+        if self.bursts:
+            b = self.bursts
+            lines.append(f"Requests per wake-up: n={len(b)} avg={sum(b) / len(b):.2f} "
+                         f"min={min(b)} max={max(b)}")
+        if self.errors_injected:
+            lines.append(f"Errors injected: {self.errors_injected}")
+        lines.append("-- Device requests (arrival to response) --")
+        for op in sorted(self.service):
+            lines.append(self.service[op].format(f"{op} ({self.bytes[op]} bytes)"))
+        if self.round_trip:
+            lines.append("-- Pushed changes (push to device acknowledgment) --")
+            for op in sorted(self.round_trip):
+                lines.append(self.round_trip[op].format(op))
+        return "\n".join(lines)
+
+
+class StandIn:
+    """Shared state and fault injection for all resources"""
+
+    def __init__(self, args):
+        self.args = args
+        self.stats = Stats(args.burst_gap_s)
+
+    async def serve(self, op, request):
+        """Account for a device request; returns an error response to inject, if any"""
+        start = self.stats.request(op, request)
+        delay = self.args.delay_ms + random.uniform(0, self.args.jitter_ms)
+        if delay > 0:
+            await asyncio.sleep(delay / 1000.0)
+        self.stats.service[op].add(now_ms() - start)
+
+        if random.random() * 100 < self.args.error_pct:
+            self.stats.errors_injected += 1
+            return aiocoap.Message(code=aiocoap.SERVICE_UNAVAILABLE)
+        return None
+
+
+def decode(payload):
+    if not payload:
+        return None
+    try:
+        return cbor2.loads(payload)
+    except Exception:
+        logging.warning("Undecodable payload: %s", payload.hex())
+        return None
+
+
+class StreamSite(interfaces.Resource, interfaces.PathCapable):
+    """Every path under .s, and the log service"""
+
+    def __init__(self, standin, prefix):
+        self.standin = standin
+        self.prefix = prefix
+
+    async def needs_blockwise_assembly(self, request):
+        return True
+
+    async def render(self, request):
+        op = "/".join((self.prefix,) + tuple(request.opt.uri_path))
+        error = await self.standin.serve(op, request)
+        return error or aiocoap.Message(code=aiocoap.CHANGED)
+
+
+class ObservableCbor(resource.ObservableResource):
+    """An observable CBOR document that the device may also write"""
+
+    def __init__(self, standin, op, value):
+        super().__init__()
+        self.standin = standin
+        self.op = op
+        self.value = value
+
+    def push(self, value):
+        self.value = value
+        self.updated_state()
+
+    async def render_get(self, request):
+        payload = b"" if self.value is None else cbor2.dumps(self.value)
+        return aiocoap.Message(payload=payload, content_format=CBOR)
+
+    async def render_post(self, request):
+        error = await self.standin.serve(f"{self.op} write", request)
+        if error:
+            return error
+        self.written(decode(request.payload))
+        return aiocoap.Message(code=aiocoap.CHANGED)
+
+    render_put = render_post
+
+    async def render_delete(self, request):
+        error = await self.standin.serve(f"{self.op} delete", request)
+        if error:
+            return error
+        self.value = None
+        return aiocoap.Message(code=aiocoap.DELETED)
+
+    def written(self, value):
+        self.value = value
+
+
+class Desired(ObservableCbor):
+    """The device applies a desired counter and writes -1 back to acknowledge it"""
+
+    def __init__(self, standin):
+        super().__init__(standin, ".d/desired", {"counter_up": -1, "counter_down": -1})
+        self.pending = {}
+
+    def change(self):
+        key = random.choice(("counter_up", "counter_down"))
+        value = dict(self.value or {}, **{key: random.randint(0, 10000)})
+        self.pending[key] = now_ms()
+        self.push(value)
+
+    def written(self, value):
+        for key, v in (value or {}).items():
+            if v == -1 and key in self.pending:
+                rtt = now_ms() - self.pending.pop(key)
+                self.standin.stats.round_trip["desired"].add(rtt)
+        self.value = value
+
+
+class State(resource.Resource):
+    def __init__(self, standin):
+        super().__init__()
+        self.standin = standin
+        self.value = None
+
+    async def render_post(self, request):
+        error = await self.standin.serve(".d/state write", request)
+        if error:
+            return error
+        self.value = decode(request.payload)
+        return aiocoap.Message(code=aiocoap.CHANGED)
+
+    render_put = render_post
+
+    async def render_get(self, request):
+        return aiocoap.Message(payload=cbor2.dumps(self.value), content_format=CBOR)
+
+
+class Settings(ObservableCbor):
+    def __init__(self, standin, initial):
+        super().__init__(standin, ".c", {"version": 1, "settings": initial})
+        self.pending = {}
+
+    def change(self, key, value):
+        version = self.value["version"] + 1
+        settings = dict(self.value["settings"], **{key: value})
+        self.pending[version] = now_ms()
+        self.push({"version": version, "settings": settings})
+
+
+class SettingsStatus(resource.Resource):
+    def __init__(self, standin, settings):
+        super().__init__()
+        self.standin = standin
+        self.settings = settings
+
+    async def render_post(self, request):
+        error = await self.standin.serve(".c/status", request)
+        if error:
+            return error
+        status = decode(request.payload) or {}
+        sent = self.settings.pending.pop(status.get("version"), None)
+        if sent is not None:
+            self.standin.stats.round_trip["settings"].add(now_ms() - sent)
+        return aiocoap.Message(code=aiocoap.CHANGED)
+
+
+class Rpc(ObservableCbor):
+    def __init__(self, standin):
+        super().__init__(standin, ".rpc", None)
+        self.pending = {}
+        self.next_id = 1
+
+    def call(self, method, params):
+        call_id = str(self.next_id)
+        self.next_id += 1
+        self.pending[call_id] = (method, now_ms())
+        self.push({"id": call_id, "method": method, "params": params})
+
+
+class RpcStatus(resource.Resource):
+    def __init__(self, standin, rpc):
+        super().__init__()
+        self.standin = standin
+        self.rpc = rpc
+
+    async def render_post(self, request):
+        error = await self.standin.serve(".rpc/status", request)
+        if error:
+            return error
+        status = decode(request.payload) or {}
+        call = self.rpc.pending.pop(str(status.get("id")), None)
+        if call is not None:
+            method, sent = call
+            self.standin.stats.round_trip[f"rpc {method}"].add(now_ms() - sent)
+            logging.debug("RPC %s: %s", method, status)
+        return aiocoap.Message(code=aiocoap.CHANGED)
+
+
+async def every(interval_s, action):
+    while True:
+        await asyncio.sleep(interval_s)
+        action()
+
+
+def parse_setting(text):
+    key, _, values = text.partition("=")
+    return key, [int(v) if v.lstrip("-").isdigit() else v for v in values.split(",")]
+
+
+async def main(args):
+    standin = StandIn(args)
+    settings = Settings(standin, {})
+    rpc = Rpc(standin)
+    desired = Desired(standin)
+
+    site = resource.Site()
+    site.add_resource([".s"], StreamSite(standin, ".s"))
+    site.add_resource([".logs"], StreamSite(standin, ".logs"))
+    site.add_resource([".d", "state"], State(standin))
+    site.add_resource([".d", "desired"], desired)
+    site.add_resource([".c"], settings)
+    site.add_resource([".c", "status"], SettingsStatus(standin, settings))
+    site.add_resource([".rpc"], rpc)
+    site.add_resource([".rpc", "status"], RpcStatus(standin, rpc))
+    site.add_resource([".u", "desired"], ObservableCbor(standin, ".u/desired", None))
+
+    if args.no_dtls:
+        transports = ["udp6"]
+        port = args.port or aiocoap.COAP_PORT
+    else:
+        transports = ["tinydtls_server"]
+        port = args.port or aiocoap.COAPS_PORT
+
+    context = await aiocoap.Context.create_server_context(
+        site, bind=(args.bind, port), transports=transports)
+    if not args.no_dtls:
+        context.server_credentials.load_from_dict({
+            ":client": {"dtls": {"psk": {"ascii": args.psk},
+                                 "client-identity": {"ascii": args.psk_id}}}})
+
+    tasks = []
+    for spec in args.rpc:
+        method, _, interval = spec.partition(":")
+        tasks.append(every(float(interval or 30), lambda m=method: rpc.call(m, [])))
+    if args.setting:
+        key, values = parse_setting(args.setting)
+        cycle = itertools.cycle(values)
+        settings.value["settings"][key] = next(cycle)
+        tasks.append(every(args.settings_every_s,
+                           lambda: settings.change(key, next(cycle))))
+    if args.desired_every_s:
+        tasks.append(every(args.desired_every_s, desired.change))
+    tasks.append(every(args.report_s, lambda: print(standin.stats.report(), flush=True)))
+
+    logging.info("Golioth stand-in listening on %s port %d (%s)", args.bind, port,
+                 "CoAP" if args.no_dtls else f"DTLS PSK, identity {args.psk_id}")
+
+    stop = asyncio.Event()
+    asyncio.get_running_loop().add_signal_handler(signal.SIGINT, stop.set)
+    running = [asyncio.create_task(t) for t in tasks]
+    await stop.wait()
+
+    for task in running:
+        task.cancel()
+    await context.shutdown()
+    print(standin.stats.report())
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--bind", default="::", help="address to listen on")
+    parser.add_argument("--port", type=int, help="default 5684, or 5683 with --no-dtls")
+    parser.add_argument("--no-dtls", action="store_true", help="serve plain CoAP")
+    parser.add_argument("--psk-id", default="standin@local")
+    parser.add_argument("--psk", default="standin-psk")
+    parser.add_argument("--delay-ms", type=float, default=0,
+                        help="added before every response, to emulate the network")
+    parser.add_argument("--jitter-ms", type=float, default=0,
+                        help="random extra delay up to this much")
+    parser.add_argument("--error-pct", type=float, default=0,
+                        help="answer this share of requests with 5.03")
+    parser.add_argument("--rpc", action="append", default=[], metavar="METHOD[:S]",
+                        help="call METHOD every S seconds (default 30), may repeat")
+    parser.add_argument("--setting", metavar="KEY=V1,V2,...",
+                        help="cycle KEY through the values every --settings-every-s")
+    parser.add_argument("--settings-every-s", type=float, default=60)
+    parser.add_argument("--desired-every-s", type=float, default=0,
+                        help="change a desired counter this often")
+    parser.add_argument("--burst-gap-s", type=float, default=1.0,
+                        help="quiet time that ends a wake-up")
+    parser.add_argument("--report-s", type=float, default=60)
+    parser.add_argument("-v", "--verbose", action="store_true")
+    args = parser.parse_args()
+
+    logging.basicConfig(level=logging.DEBUG if args.verbose else logging.INFO,
+                        format="%(asctime)s %(levelname)s %(message)s")
+    asyncio.run(main(args))